@@ -0,0 +1,584 @@
+/*
+ * This file contains fixed-width unsigned integers: N 64-bit limbs on the
+ * stack, for modular arithmetic on numbers of a few hundred bits without
+ * the heap allocations and size dispatch of boost's cpp_int.  Everything
+ * here is header-only, since it is all templated on the width.
+ */
+
+
+#ifndef BR_FIXEDINT_HPP
+#define BR_FIXEDINT_HPP
+
+#include<cstdint>
+#include<string>
+#include<algorithm>
+
+namespace nt
+{
+    /**
+     * Fixed-Width Unsigned Integer
+     * An unsigned integer of 64*N bits, stored as N limbs, least significant
+     * first.  Arithmetic wraps modulo 2^(64N) like the built-in unsigned
+     * types.  Supports + - * / %, shifts, bitwise operations and comparisons,
+     * and converts to and from decimal strings.
+     * Notes: Division by zero gives quotient 0 and remainder the dividend,
+     * rather than a crash.  Products that need all 2N limbs are given by
+     * mulWide.  Conversions between widths are explicit, and truncate.
+     */
+    template<int N>
+    struct FixedUInt
+    {
+	static_assert(N>=1, "FixedUInt needs at least one limb");
+	static constexpr int LIMBS = N;
+	static constexpr int BITS = 64*N;
+
+	uint64_t limbs[N];
+
+	constexpr FixedUInt() : limbs() {}
+	constexpr FixedUInt(uint64_t x) : limbs() { limbs[0] = x; }
+
+	template<int M>
+	constexpr explicit FixedUInt(const FixedUInt<M> & other) : limbs()
+	{
+	    for(int i=0; i<N && i<M; i++) limbs[i] = other.limbs[i];
+	}
+
+	// 2^(64N) - 1
+	static constexpr FixedUInt max()
+	{
+	    FixedUInt x;
+	    for(int i=0; i<N; i++) x.limbs[i] = ~(uint64_t)0;
+	    return x;
+	}
+
+	constexpr bool isZero() const
+	{
+	    for(int i=0; i<N; i++)
+	    {
+		if(limbs[i]) return false;
+	    }
+	    return true;
+	}
+	constexpr explicit operator bool() const { return !isZero(); }
+	constexpr bool isOdd() const { return limbs[0]&1; }
+
+	// the number of significant limbs and bits
+	constexpr int limbLength() const
+	{
+	    int n = N;
+	    while(n>0 && limbs[n-1]==0) n--;
+	    return n;
+	}
+	constexpr int bitLength() const
+	{
+	    int n = limbLength();
+	    return n==0 ? 0 : 64*n - __builtin_clzll(limbs[n-1]);
+	}
+	constexpr bool bit(int i) const { return (limbs[i/64] >> (i%64)) & 1; }
+
+	// the number of trailing zero bits; 0 for 0
+	constexpr int trailingZeros() const
+	{
+	    for(int i=0; i<N; i++)
+	    {
+		if(limbs[i]) return 64*i + __builtin_ctzll(limbs[i]);
+	    }
+	    return 0;
+	}
+
+	constexpr FixedUInt & operator+=(const FixedUInt & b)
+	{
+	    unsigned __int128 carry = 0;
+	    for(int i=0; i<N; i++)
+	    {
+		carry += (unsigned __int128)limbs[i] + b.limbs[i];
+		limbs[i] = (uint64_t)carry;
+		carry >>= 64;
+	    }
+	    return *this;
+	}
+
+	constexpr FixedUInt & operator-=(const FixedUInt & b)
+	{
+	    uint64_t borrow = 0;
+	    for(int i=0; i<N; i++)
+	    {
+		unsigned __int128 d = (unsigned __int128)limbs[i] - b.limbs[i] - borrow;
+		limbs[i] = (uint64_t)d;
+		borrow = (uint64_t)(d >> 64) & 1;
+	    }
+	    return *this;
+	}
+
+	// the product mod 2^(64N), skipping the limbs that would overflow
+	constexpr FixedUInt & operator*=(const FixedUInt & b)
+	{
+	    FixedUInt product;
+	    for(int i=0; i<N; i++)
+	    {
+		if(limbs[i]==0) continue;
+		unsigned __int128 carry = 0;
+		for(int j=0; i+j<N; j++)
+		{
+		    carry += (unsigned __int128)limbs[i]*b.limbs[j] + product.limbs[i+j];
+		    product.limbs[i+j] = (uint64_t)carry;
+		    carry >>= 64;
+		}
+	    }
+	    return *this = product;
+	}
+
+	constexpr FixedUInt & operator<<=(int shift)
+	{
+	    if(shift>=BITS) return *this = FixedUInt();
+	    int whole = shift/64, part = shift%64;
+	    for(int i=N-1; i>=0; i--)
+	    {
+		uint64_t x = i>=whole ? limbs[i-whole] << part : 0;
+		if(part && i>whole) x |= limbs[i-whole-1] >> (64-part);
+		limbs[i] = x;
+	    }
+	    return *this;
+	}
+
+	constexpr FixedUInt & operator>>=(int shift)
+	{
+	    if(shift>=BITS) return *this = FixedUInt();
+	    int whole = shift/64, part = shift%64;
+	    for(int i=0; i<N; i++)
+	    {
+		uint64_t x = i+whole<N ? limbs[i+whole] >> part : 0;
+		if(part && i+whole+1<N) x |= limbs[i+whole+1] << (64-part);
+		limbs[i] = x;
+	    }
+	    return *this;
+	}
+
+	constexpr FixedUInt & operator&=(const FixedUInt & b) { for(int i=0; i<N; i++) limbs[i] &= b.limbs[i]; return *this; }
+	constexpr FixedUInt & operator|=(const FixedUInt & b) { for(int i=0; i<N; i++) limbs[i] |= b.limbs[i]; return *this; }
+	constexpr FixedUInt & operator^=(const FixedUInt & b) { for(int i=0; i<N; i++) limbs[i] ^= b.limbs[i]; return *this; }
+
+	FixedUInt & operator/=(const FixedUInt & b);
+	FixedUInt & operator%=(const FixedUInt & b);
+
+	// decimal conversions; fromString stops at the first non-digit
+	std::string toString() const;
+	static FixedUInt fromString(const std::string & digits);
+    };
+
+    template<int N> constexpr FixedUInt<N> operator+(FixedUInt<N> a, const FixedUInt<N> & b) { return a += b; }
+    template<int N> constexpr FixedUInt<N> operator-(FixedUInt<N> a, const FixedUInt<N> & b) { return a -= b; }
+    template<int N> constexpr FixedUInt<N> operator*(FixedUInt<N> a, const FixedUInt<N> & b) { return a *= b; }
+    template<int N> FixedUInt<N> operator/(FixedUInt<N> a, const FixedUInt<N> & b) { return a /= b; }
+    template<int N> FixedUInt<N> operator%(FixedUInt<N> a, const FixedUInt<N> & b) { return a %= b; }
+    template<int N> constexpr FixedUInt<N> operator<<(FixedUInt<N> a, int shift) { return a <<= shift; }
+    template<int N> constexpr FixedUInt<N> operator>>(FixedUInt<N> a, int shift) { return a >>= shift; }
+    template<int N> constexpr FixedUInt<N> operator&(FixedUInt<N> a, const FixedUInt<N> & b) { return a &= b; }
+    template<int N> constexpr FixedUInt<N> operator|(FixedUInt<N> a, const FixedUInt<N> & b) { return a |= b; }
+    template<int N> constexpr FixedUInt<N> operator^(FixedUInt<N> a, const FixedUInt<N> & b) { return a ^= b; }
+
+    // -1, 0 or 1 as a is less than, equal to or greater than b
+    template<int N>
+    constexpr int compare(const FixedUInt<N> & a, const FixedUInt<N> & b)
+    {
+	for(int i=N-1; i>=0; i--)
+	{
+	    if(a.limbs[i]!=b.limbs[i]) return a.limbs[i]<b.limbs[i] ? -1 : 1;
+	}
+	return 0;
+    }
+
+    template<int N> constexpr bool operator==(const FixedUInt<N> & a, const FixedUInt<N> & b) { return compare(a, b)==0; }
+    template<int N> constexpr bool operator!=(const FixedUInt<N> & a, const FixedUInt<N> & b) { return compare(a, b)!=0; }
+    template<int N> constexpr bool operator<(const FixedUInt<N> & a, const FixedUInt<N> & b) { return compare(a, b)<0; }
+    template<int N> constexpr bool operator<=(const FixedUInt<N> & a, const FixedUInt<N> & b) { return compare(a, b)<=0; }
+    template<int N> constexpr bool operator>(const FixedUInt<N> & a, const FixedUInt<N> & b) { return compare(a, b)>0; }
+    template<int N> constexpr bool operator>=(const FixedUInt<N> & a, const FixedUInt<N> & b) { return compare(a, b)>=0; }
+
+    typedef FixedUInt<2> UInt128;
+    typedef FixedUInt<4> UInt256;
+    typedef FixedUInt<8> UInt512;
+
+    // the full 2N-limb product
+    template<int N>
+    constexpr FixedUInt<2*N> mulWide(const FixedUInt<N> & a, const FixedUInt<N> & b)
+    {
+	FixedUInt<2*N> product;
+	for(int i=0; i<N; i++)
+	{
+	    unsigned __int128 carry = 0;
+	    for(int j=0; j<N; j++)
+	    {
+		carry += (unsigned __int128)a.limbs[i]*b.limbs[j] + product.limbs[i+j];
+		product.limbs[i+j] = (uint64_t)carry;
+		carry >>= 64;
+	    }
+	    product.limbs[i+N] = (uint64_t)carry;
+	}
+	return product;
+    }
+
+    /**
+     * Fixed-Width Division
+     * PARAMETERS: the dividend (a) and divisor (b), and the quotient and
+     * remainder to fill in
+     * RETURN: Nothing, but a = quotient*b + remainder with remainder < b.
+     * Notes: Knuth's algorithm D on 64-bit limbs, with a single-limb fast
+     * path.  If b is 0, the quotient is 0 and the remainder is a.
+     */
+    template<int N>
+    void divmod(const FixedUInt<N> & a, const FixedUInt<N> & b, FixedUInt<N> & quotient, FixedUInt<N> & remainder)
+    {
+	int n = b.limbLength(), m = a.limbLength();
+	if(n==0 || a<b)
+	{
+	    remainder = a;
+	    quotient = FixedUInt<N>();
+	    return;
+	}
+	FixedUInt<N> q;
+	if(n==1)
+	{
+	    unsigned __int128 r = 0;
+	    for(int i=m-1; i>=0; i--)
+	    {
+		r = (r << 64) | a.limbs[i];
+		q.limbs[i] = (uint64_t)(r / b.limbs[0]);
+		r %= b.limbs[0];
+	    }
+	    quotient = q;
+	    remainder = FixedUInt<N>((uint64_t)r);
+	    return;
+	}
+
+	// normalize so that the top limb of the divisor has its high bit set
+	int s = __builtin_clzll(b.limbs[n-1]);
+	uint64_t u[N+1] = {}, v[N] = {};
+	for(int i=n-1; i>0; i--) v[i] = (b.limbs[i] << s) | (s ? b.limbs[i-1] >> (64-s) : 0);
+	v[0] = b.limbs[0] << s;
+	u[m] = s ? a.limbs[m-1] >> (64-s) : 0;
+	for(int i=m-1; i>0; i--) u[i] = (a.limbs[i] << s) | (s ? a.limbs[i-1] >> (64-s) : 0);
+	u[0] = a.limbs[0] << s;
+
+	const unsigned __int128 base = (unsigned __int128)1 << 64;
+	for(int j=m-n; j>=0; j--)
+	{
+	    // estimate the quotient limb from the top two limbs, then correct
+	    unsigned __int128 top = ((unsigned __int128)u[j+n] << 64) | u[j+n-1];
+	    unsigned __int128 qhat = top / v[n-1], rhat = top % v[n-1];
+	    while(qhat>=base || qhat*v[n-2] > ((rhat << 64) | u[j+n-2]))
+	    {
+		qhat--;
+		rhat += v[n-1];
+		if(rhat>=base) break;
+	    }
+	    // u -= qhat*v, shifted by j limbs
+	    __int128 t = 0;
+	    unsigned __int128 k = 0;
+	    for(int i=0; i<n; i++)
+	    {
+		unsigned __int128 p = qhat*v[i];
+		t = (__int128)u[i+j] - (__int128)k - (__int128)(uint64_t)p;
+		u[i+j] = (uint64_t)t;
+		k = (p >> 64) - (t >> 64);
+	    }
+	    t = (__int128)u[j+n] - (__int128)k;
+	    u[j+n] = (uint64_t)t;
+	    q.limbs[j] = (uint64_t)qhat;
+	    // qhat was one too big: add v back
+	    if(t<0)
+	    {
+		q.limbs[j]--;
+		unsigned __int128 carry = 0;
+		for(int i=0; i<n; i++)
+		{
+		    carry += (unsigned __int128)u[i+j] + v[i];
+		    u[i+j] = (uint64_t)carry;
+		    carry >>= 64;
+		}
+		u[j+n] += (uint64_t)carry;
+	    }
+	}
+	FixedUInt<N> r;
+	for(int i=0; i<n; i++) r.limbs[i] = (u[i] >> s) | (s ? u[i+1] << (64-s) : 0);
+	quotient = q;
+	remainder = r;
+    }
+
+    template<int N>
+    FixedUInt<N> & FixedUInt<N>::operator/=(const FixedUInt<N> & b)
+    {
+	FixedUInt<N> r;
+	divmod(*this, b, *this, r);
+	return *this;
+    }
+
+    template<int N>
+    FixedUInt<N> & FixedUInt<N>::operator%=(const FixedUInt<N> & b)
+    {
+	FixedUInt<N> q;
+	divmod(*this, b, q, *this);
+	return *this;
+    }
+
+    template<int N>
+    std::string FixedUInt<N>::toString() const
+    {
+	if(isZero()) return "0";
+	const uint64_t chunk = 10000000000000000000ULL; // 10^19
+	std::string digits;
+	FixedUInt<N> x = *this, q, r;
+	while(!x.isZero())
+	{
+	    divmod(x, FixedUInt<N>(chunk), q, r);
+	    uint64_t part = r.limbs[0];
+	    for(int i=0; i<19 && (part || !q.isZero()); i++)
+	    {
+		digits.push_back('0' + part%10);
+		part /= 10;
+	    }
+	    x = q;
+	}
+	std::reverse(digits.begin(), digits.end());
+	return digits;
+    }
+
+    template<int N>
+    FixedUInt<N> FixedUInt<N>::fromString(const std::string & digits)
+    {
+	FixedUInt<N> x;
+	for(size_t i=0; i<digits.size() && digits[i]>='0' && digits[i]<='9'; i++)
+	{
+	    x *= FixedUInt<N>(10);
+	    x += FixedUInt<N>((uint64_t)(digits[i]-'0'));
+	}
+	return x;
+    }
+
+    /**
+     * Fixed-Width Montgomery Context
+     * Montgomery multiplication modulo an odd modulus m of up to 64*N bits,
+     * with R = 2^(64N), by the CIOS method (the reduction interleaved with
+     * the product, one limb at a time), so no division is done after the
+     * constructor.
+     *
+     * CONSTRUCTOR PARAMETERS: the modulus, which must be odd
+     * Notes: mul, square and pow take and return numbers in Montgomery form
+     * (aR mod m), all in [0, m).  toMontgomery reduces its argument first.
+     */
+    template<int N>
+    class FixedMontgomery
+    {
+    public:
+	explicit FixedMontgomery(const FixedUInt<N> & modulus) : m(modulus)
+	{
+	    // -m^-1 mod 2^64, by Newton's iteration
+	    uint64_t inverse = m.limbs[0];
+	    for(int i=0; i<5; i++) inverse *= 2-m.limbs[0]*inverse;
+	    mInverse = -inverse;
+	    // R mod m and R^2 mod m, by doubling
+	    FixedUInt<N> x = FixedUInt<N>(1) % m;
+	    for(int i=0; i<2*FixedUInt<N>::BITS; i++)
+	    {
+		if(i==FixedUInt<N>::BITS) rOne = x;
+		bool overflow = x.limbs[N-1] >> 63;
+		x <<= 1;
+		if(overflow || x>=m) x -= m;
+	    }
+	    r2 = x;
+	}
+
+	// the modulus
+	const FixedUInt<N> & modulus() const { return m; }
+
+	// R mod m, which is 1 in Montgomery form
+	const FixedUInt<N> & one() const { return rOne; }
+
+	FixedUInt<N> toMontgomery(const FixedUInt<N> & a) const { return mul(a<m ? a : a%m, r2); }
+	FixedUInt<N> fromMontgomery(const FixedUInt<N> & a) const { return mul(a, FixedUInt<N>(1)); }
+
+	// a*b/R mod m
+	FixedUInt<N> mul(const FixedUInt<N> & a, const FixedUInt<N> & b) const
+	{
+	    uint64_t t[N+2] = {};
+	    for(int i=0; i<N; i++)
+	    {
+		unsigned __int128 carry = 0;
+		for(int j=0; j<N; j++)
+		{
+		    carry += (unsigned __int128)a.limbs[j]*b.limbs[i] + t[j];
+		    t[j] = (uint64_t)carry;
+		    carry >>= 64;
+		}
+		carry += t[N];
+		t[N] = (uint64_t)carry;
+		t[N+1] = (uint64_t)(carry >> 64);
+
+		uint64_t q = t[0]*mInverse;
+		carry = (unsigned __int128)q*m.limbs[0] + t[0];
+		carry >>= 64;
+		for(int j=1; j<N; j++)
+		{
+		    carry += (unsigned __int128)q*m.limbs[j] + t[j];
+		    t[j-1] = (uint64_t)carry;
+		    carry >>= 64;
+		}
+		carry += t[N];
+		t[N-1] = (uint64_t)carry;
+		t[N] = t[N+1] + (uint64_t)(carry >> 64);
+	    }
+	    FixedUInt<N> result;
+	    for(int i=0; i<N; i++) result.limbs[i] = t[i];
+	    if(t[N] || result>=m) result -= m;
+	    return result;
+	}
+
+	FixedUInt<N> square(const FixedUInt<N> & a) const { return mul(a, a); }
+
+	// base^exponent, with a fixed window of 4 bits
+	template<int M>
+	FixedUInt<N> pow(const FixedUInt<N> & base, const FixedUInt<M> & exponent) const
+	{
+	    FixedUInt<N> table[16];
+	    table[0] = rOne;
+	    for(int i=1; i<16; i++) table[i] = mul(table[i-1], base);
+	    FixedUInt<N> ans = rOne;
+	    int top = (exponent.bitLength()+3)/4*4;
+	    for(int bit=top-4; bit>=0; bit -= 4)
+	    {
+		for(int i=0; i<4; i++) ans = square(ans);
+		int window = (int)((exponent.limbs[bit/64] >> (bit%64)) & 15);
+		if(window) ans = mul(ans, table[window]);
+	    }
+	    return ans;
+	}
+
+    private:
+	FixedUInt<N> m, rOne, r2;
+	uint64_t mInverse;
+    };
+
+    /**
+     * Fixed-Width Modular Multiplication
+     * PARAMETERS: a, b and the modulus
+     * RETURN: a*b mod modulus, through the full 2N-limb product.  0 if the
+     * modulus is 0.
+     */
+    template<int N>
+    FixedUInt<N> mulmod(const FixedUInt<N> & a, const FixedUInt<N> & b, const FixedUInt<N> & modulus)
+    {
+	if(modulus.isZero()) return FixedUInt<N>();
+	return FixedUInt<N>(mulWide(a, b) % FixedUInt<2*N>(modulus));
+    }
+
+    /**
+     * Greatest Common Divisor, for fixed-width integers
+     * PARAMETERS: two fixed-width integers
+     * RETURN: their greatest common divisor; 0 if both are 0
+     * Notes: Stein's binary algorithm, as for the built-in types.
+     */
+    template<int N>
+    FixedUInt<N> gcd(FixedUInt<N> a, FixedUInt<N> b)
+    {
+	if(a.isZero()) return b;
+	if(b.isZero()) return a;
+	int shift = std::min(a.trailingZeros(), b.trailingZeros());
+	a >>= a.trailingZeros();
+	while(!b.isZero())
+	{
+	    b >>= b.trailingZeros();
+	    if(a>b) std::swap(a, b);
+	    b -= a;
+	}
+	return a << shift;
+    }
+
+    /**
+     * Modular Exponentiation, for fixed-width integers
+     * PARAMETERS: the base, exponent and modulus
+     * RETURN: base^exponent mod modulus
+     * Notes: If the modulus is 0, max() is returned (the counterpart of the
+     * -1 of the signed versions).  A zero exponent gives 1, even modulo 1.
+     * Odd moduli use FixedMontgomery; even ones use mulmod.
+     */
+    template<int N>
+    FixedUInt<N> powmod(const FixedUInt<N> & base, const FixedUInt<N> & exponent, const FixedUInt<N> & modulus)
+    {
+	if(modulus.isZero()) return FixedUInt<N>::max();
+	if(modulus==FixedUInt<N>(1)) return FixedUInt<N>(exponent.isZero() ? 1 : 0);
+	if(modulus.isOdd())
+	{
+	    FixedMontgomery<N> mont(modulus);
+	    return mont.fromMontgomery(mont.pow(mont.toMontgomery(base), exponent));
+	}
+	FixedUInt<N> ans(1), aux = base % modulus;
+	for(int bit=exponent.bitLength()-1; bit>=0; bit--)
+	{
+	    ans = mulmod(ans, ans, modulus);
+	    if(exponent.bit(bit)) ans = mulmod(ans, aux, modulus);
+	}
+	return ans;
+    }
+
+    /**
+     * Modular Inverse, for fixed-width integers
+     * PARAMETERS: the number a to invert, and the modulus
+     * RETURN: the inverse of a modulo the modulus
+     * Notes: In case the modulus is zero or there is no inverse, 0 is
+     * returned.  If the modulus is 1, returns 1.  The extended Euclidean
+     * algorithm keeps the magnitudes of the Bezout coefficients, whose signs
+     * alternate, so everything stays unsigned and below the modulus.
+     */
+    template<int N>
+    FixedUInt<N> modularInverse(const FixedUInt<N> & a, const FixedUInt<N> & modulus)
+    {
+	if(modulus.isZero()) return FixedUInt<N>();
+	if(modulus==FixedUInt<N>(1)) return FixedUInt<N>(1);
+	FixedUInt<N> r0 = modulus, r1 = a % modulus, t0, t1(1), q, r;
+	bool negative = false; // the sign of t1; t0 has the other one
+	while(!r1.isZero())
+	{
+	    divmod(r0, r1, q, r);
+	    r0 = r1;
+	    r1 = r;
+	    FixedUInt<N> t = t0 + q*t1;
+	    t0 = t1;
+	    t1 = t;
+	    negative = !negative;
+	}
+	if(r0!=FixedUInt<N>(1)) return FixedUInt<N>();
+	// t0 carries the sign opposite to t1's
+	return negative ? t0 : modulus - t0;
+    }
+
+    /**
+     * System of Congruences Solver, for fixed-width integers
+     * PARAMETERS: a, firstModulus, b, secondModulus
+     * RETURN: the smallest solution to x = a (mod firstModulus),
+     * x = b (mod secondModulus), if there is one, and max() if there is not.
+     * Notes: The moduli need not be coprime.  If either modulus is 0, or
+     * the solution does not fit in N limbs, max() is returned.
+     */
+    template<int N>
+    FixedUInt<N> solveModularSystem(const FixedUInt<N> & a, const FixedUInt<N> & firstModulus, const FixedUInt<N> & b, const FixedUInt<N> & secondModulus)
+    {
+	if(firstModulus.isZero() || secondModulus.isZero()) return FixedUInt<N>::max();
+	FixedUInt<N> g = gcd(firstModulus, secondModulus);
+	FixedUInt<N> x = a % firstModulus, y = b % secondModulus;
+	if(x%g != y%g) return FixedUInt<N>::max();
+	// x + firstModulus*k, with k = (y-x)/g / (firstModulus/g) mod secondModulus/g
+	FixedUInt<N> reduced = secondModulus/g;
+	FixedUInt<N> xr = x % secondModulus;
+	FixedUInt<N> diff = y>=xr ? y-xr : y+(secondModulus-xr);
+	FixedUInt<N> k = mulmod(diff/g % reduced, modularInverse((firstModulus/g) % reduced, reduced), reduced);
+	FixedUInt<2*N> solution = mulWide(firstModulus, k) + FixedUInt<2*N>(x);
+	for(int i=N; i<2*N; i++)
+	{
+	    if(solution.limbs[i]) return FixedUInt<N>::max();
+	}
+	return FixedUInt<N>(solution);
+    }
+
+}
+
+#endif
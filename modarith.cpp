@@ -1,38 +1,52 @@
 // implementation of modular arithmetic functions
 
 #include "numthy/modarith.hpp"
+#include "numthy/ntt.hpp"
 #include<cmath>
+#include<algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include<immintrin.h>
+#define BR_MODARITH_SIMD
+#endif
 
 namespace nt
 {
-    //Greatest Common Divisor
+    //Greatest Common Divisor, by Stein's binary algorithm: strip the common
+    //factors of 2, then keep subtracting the smaller number from the larger
+    //and dividing out the 2s, which needs no division at all
     int gcd(int a, int b)
     {
-	int temp;
-	a = std::abs(a);
-	b = std::abs(b);
-
-	while(b>0)
-	{
-	    temp = b;
-	    b = a%b;
-	    a = temp;
-	}
-	return a;
+	return (int)gcd((long)a, (long)b);
     }
     long gcd(long a, long b)
     {
-	long temp;
-	a = std::abs(a);
-	b = std::abs(b);
+	return (long)binaryGcd(a<0 ? -(uint64_t)a : a, b<0 ? -(uint64_t)b : b);
+    }
+    uint64_t binaryGcd(uint64_t x, uint64_t y)
+    {
+	if(x==0) return y;
+	if(y==0) return x;
 
-	while(b>0)
+	int xZeros = __builtin_ctzll(x), yZeros = __builtin_ctzll(y);
+	int shift = std::min(xZeros, yZeros);
+	// x and y are odd once their 2s are stripped, and are kept as their
+	// halves x>>1 and y>>1: for odd x and y, x-y = 2*((x>>1)-(y>>1)), and
+	// the halves are below 2^63, so their difference fits in a long, and
+	// its sign gives the min and the absolute value without branches.  The
+	// trailing zeros of the next x are counted while the min is taken,
+	// which keeps the ctz off the critical path
+	y >>= yZeros+1;
+	xZeros++;
+	while(x>0)
 	{
-	    temp = b;
-	    b = a%b;
-	    a = temp;
+	    x >>= xZeros;
+	    long diff = (long)x - (long)y, sign = diff >> 63;
+	    xZeros = __builtin_ctzll(diff | (uint64_t)1 << 62) + 1;
+	    y += diff & sign;
+	    x = (diff ^ sign) - sign;
 	}
-	return a;
+	return (2*y+1) << shift;
     }
 
     //Least Common Multiple
@@ -48,34 +62,30 @@ namespace nt
     int powmod(long base, long exponent, int modulus)
     {
 	if(modulus==0) return -1;
-	modulus = std::abs(modulus);
-
-	long ans = 1;
-	long aux = (base % modulus);
-	if(aux<0) aux += modulus;
+	return Modulus(modulus).pow(base, exponent);
+    }
 
-	if(exponent < 0)
-	{
-	    aux = modularInverse((int)aux, modulus);
-	    if(aux==0) return -1;
-	    exponent = -exponent;
-	}
+    //Modular Factorial
+    // factmod hands n at least this big over to factmodPrime
+    static const int FACTMOD_FAST_MIN = 1 << 16;
 
-	while(exponent>0)
+    // trial division, for factmod's choice of method
+    bool factmod_isPrime(int n)
+    {
+	if(n<2) return false;
+	for(int q=2; (long)q*q<=n; q++)
 	{
-	    if(exponent&1) ans = (ans * aux) % modulus;
-	    exponent >>= 1;
-	    aux = (aux * aux) % modulus;
+	    if(n%q==0) return false;
 	}
-	return (int)ans;
+	return true;
     }
 
-    //Modular Factorial
     int factmod(int n, int modulus)
     {
 	if(n<0 || modulus==0) return -1;
 	modulus = std::abs(modulus);
 	if(n>=modulus) return 0;
+	if(n>=FACTMOD_FAST_MIN && factmod_isPrime(modulus)) return factmodPrime(n, modulus);
 
 	long ans = 1;
 	for(int k=2; k<=n; k++)
@@ -85,6 +95,134 @@ namespace nt
 	return (int)ans;
     }
 
+    // g(x) = (vx+1)(vx+2)...(vx+v) at x = 0, ..., v, by min_25's doubling:
+    // with g_d the product of d terms,
+    //   g_2d(x) = g_d(x) * g_d(x + d/v),  g_(d+1)(x) = g_d(x) * (vx + d+1),
+    // where the samples of g_d are shifted to d+1, d/v and d/v + d+1.  All
+    // the shifts are valid as long as v^2 + 2v < p.  Returns false if a
+    // shift fails anyway.
+    bool factmodPrime_blocks(int v, int p, std::vector<int> & values)
+    {
+	Modulus mod(p);
+	long inverseV = mod.inverse(v);
+	values.assign(1, 1);
+	values.push_back(mod.reduce((long)v+1));
+	long d = 1;
+	std::vector<int> shifted, sampleC, sampleD;
+	for(int bit=30-__builtin_clz(v); bit>=0; bit--)
+	{
+	    long s = d*inverseV % p;
+	    if(!shiftSamples(values, d+1, shifted, p)) return false;
+	    if(!shiftSamples(values, s, sampleC, p)) return false;
+	    if(!shiftSamples(values, s+d+1, sampleD, p)) return false;
+	    values.insert(values.end(), shifted.begin(), shifted.end());
+	    sampleC.insert(sampleC.end(), sampleD.begin(), sampleD.end());
+	    values.resize(2*d+1);
+	    for(long x=0; x<=2*d; x++) values[x] = mod.mul(values[x], sampleC[x]);
+	    d *= 2;
+
+	    if((v>>bit)&1)
+	    {
+		for(long x=0; x<=d; x++) values[x] = mod.mul(values[x], mod.reduce(v*x+d+1));
+		int last = 1;
+		for(long i=1; i<=d+1; i++) last = mod.mul(last, mod.reduce(v*(d+1)+i));
+		values.push_back(last);
+		d++;
+	    }
+	}
+	return true;
+    }
+
+    // n! mod p for n <= p/2
+    int factmodPrime_half(long n, int p)
+    {
+	Modulus mod(p);
+	int ans = mod.reduce(1);
+	long done = 0;
+	if(n>=FACTMOD_FAST_MIN)
+	{
+	    int v = (int)std::sqrt((double)n);
+	    std::vector<int> values;
+	    if(factmodPrime_blocks(v, p, values))
+	    {
+		for(int x=0; x<v; x++) ans = mod.mul(ans, values[x]);
+		done = (long)v*v;
+	    }
+	}
+	for(long k=done+1; k<=n; k++) ans = mod.mul(ans, (int)k);
+	return ans;
+    }
+
+    // n! from (p-1-n)! by Wilson's theorem: n! * (-1)^(p-1-n) (p-1-n)! = -1
+    int factmodPrime_wilson(long n, int p, int mirror)
+    {
+	Modulus mod(p);
+	int ans = mod.inverse(mirror);
+	if((p-1-n)%2==0) ans = mod.reduce(-(long)ans);
+	return ans;
+    }
+
+    int factmodPrime(long n, int p)
+    {
+	if(n<0 || p<2) return -1;
+	if(n>=p) return 0;
+	if(n<=(p-1)/2) return factmodPrime_half(n, p);
+	return factmodPrime_wilson(n, p, factmodPrime_half(p-1-n, p));
+    }
+
+    int factmodPrime(long n, int p, long & exponent)
+    {
+	exponent = 0;
+	if(n<0 || p<2) return -1;
+	Modulus mod(p);
+	int ans = 1;
+	for(; n>0; n /= p)
+	{
+	    ans = mod.mul(ans, factmodPrime(n%p, p));
+	    if((n/p)%2) ans = mod.reduce(-(long)ans);
+	    exponent += n/p;
+	}
+	return ans;
+    }
+
+    void factmodPrime(const std::vector<long> & values, int p, std::vector<int> & out)
+    {
+	out.assign(values.size(), -1);
+	if(p<2) return;
+	Modulus mod(p);
+	// blocks of v integers, with v^2 >= (p-1)/2
+	int v = (int)std::sqrt((double)((p-1)/2));
+	while((long)v*v < (p-1)/2) v++;
+	std::vector<int> prefix(1, mod.reduce(1));
+	if(v>0 && (long)v*v >= FACTMOD_FAST_MIN && factmodPrime_blocks(v, p, prefix))
+	{
+	    int running = mod.reduce(1);
+	    for(int x=0; x<=v; x++)
+	    {
+		int block = prefix[x];
+		prefix[x] = running;
+		running = mod.mul(running, block);
+	    }
+	}
+	else prefix.assign(1, mod.reduce(1));
+
+	for(size_t i=0; i<values.size(); i++)
+	{
+	    long n = values[i];
+	    if(n<0) continue;
+	    if(n>=p)
+	    {
+		out[i] = 0;
+		continue;
+	    }
+	    long m = n<=(p-1)/2 ? n : p-1-n;
+	    long block = std::min(m/std::max(v, 1), (long)prefix.size()-1);
+	    int ans = prefix[block];
+	    for(long k=block*v+1; k<=m; k++) ans = mod.mul(ans, (int)k);
+	    out[i] = m==n ? ans : factmodPrime_wilson(n, p, ans);
+	}
+    }
+
     //Modular Inverse, using Extended Euclidean Algorithm
     int modularInverse(int a, int modulus)
     {
@@ -170,4 +308,428 @@ namespace nt
 	
 
     
+
+    //Modulus Context, using Barrett reduction
+    Modulus::Modulus(int modulus) : m(std::abs((long)modulus))
+    {
+	shift = 64-__builtin_clzll(m);
+	mu = ((uint64_t)1 << (2*shift)) / m;
+    }
+
+    int Modulus::reduce(long a) const
+    {
+	long r = a % (long)m;
+	return (int)(r<0 ? r+m : r);
+    }
+
+    int Modulus::pow(long base, long exponent) const
+    {
+	int ans = 1;
+	int aux = reduce(base);
+
+	if(exponent < 0)
+	{
+	    aux = inverse(aux);
+	    if(aux==0) return -1;
+	    exponent = -exponent;
+	}
+
+	while(exponent>0)
+	{
+	    if(exponent&1) ans = mul(ans, aux);
+	    exponent >>= 1;
+	    aux = mul(aux, aux);
+	}
+	return ans;
+    }
+
+    int Modulus::inverse(long a) const
+    {
+	return modularInverse(reduce(a), (int)m);
+    }
+
+    void Modulus::mul(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out) const
+    {
+	mulmod(a, b, out, (int)m);
+    }
+
+    void Modulus::pow(const std::vector<int> & bases, long exponent, std::vector<int> & out) const
+    {
+	out.resize(bases.size());
+	for(size_t i=0; i<bases.size(); i++)
+	{
+	    out[i] = reduce(bases[i]);
+	}
+	powmod(out, exponent, out, (int)m);
+    }
+
+    /* Batch Modular Arithmetic
+     * With an odd modulus m < 2^31, values are multiplied in Montgomery form
+     * with R = 2^32; a[i]*b[i] mod m is obtained as mont(mont(a[i], b[i]), R^2).
+     * The SIMD kernels work on the 32-bit lanes; the multiplications are done
+     * on the even and odd lanes separately, as 32x32->64 bit products.
+     */
+    struct batch_Montgomery32
+    {
+	// mInverse = m^-1 mod R, one = R mod m, r2 = R^2 mod m
+	uint32_t m, mInverse, one, r2;
+
+	explicit batch_Montgomery32(uint32_t m) : m(m)
+	{
+	    mInverse = m;
+	    for(int i=0; i<4; i++) mInverse *= 2-m*mInverse;
+	    one = (uint32_t)(((uint64_t)1 << 32) % m);
+	    r2 = (uint32_t)((uint64_t)one*one % m);
+	}
+
+	// a*b*R^-1 mod m, for the elements that don't fill a SIMD register
+	uint32_t mul(uint32_t a, uint32_t b) const
+	{
+	    uint64_t T = (uint64_t)a*b;
+	    uint32_t q = (uint32_t)T*mInverse;
+	    uint32_t hi = (uint32_t)(T>>32), qm = (uint32_t)(((uint64_t)q*m)>>32);
+	    return hi>=qm ? hi-qm : hi-qm+m;
+	}
+	uint32_t pow(uint32_t a, long exponent) const
+	{
+	    uint32_t ans = one;
+	    a = mul(a, r2);
+	    for(int bit=63-__builtin_clzll(exponent|1); bit>=0; bit--)
+	    {
+		ans = mul(ans, ans);
+		if((exponent>>bit)&1) ans = mul(ans, a);
+	    }
+	    return mul(ans, 1);
+	}
+    };
+
+#ifdef BR_MODARITH_SIMD
+    __attribute__((target("avx2")))
+    inline __m256i batch_montgomeryMulAVX2(__m256i a, __m256i b, __m256i m, __m256i mInverse)
+    {
+	__m256i tEven = _mm256_mul_epu32(a, b);
+	__m256i tOdd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+	__m256i qmEven = _mm256_mul_epu32(_mm256_mul_epu32(tEven, mInverse), m);
+	__m256i qmOdd = _mm256_mul_epu32(_mm256_mul_epu32(tOdd, mInverse), m);
+	// the low halves of T and q*m agree, so the result is the difference
+	// of the high halves, plus m if that is negative
+	__m256i tHigh = _mm256_blend_epi32(_mm256_srli_epi64(tEven, 32), tOdd, 0xAA);
+	__m256i qmHigh = _mm256_blend_epi32(_mm256_srli_epi64(qmEven, 32), qmOdd, 0xAA);
+	__m256i d = _mm256_sub_epi32(tHigh, qmHigh);
+	return _mm256_min_epu32(d, _mm256_add_epi32(d, m));
+    }
+
+    __attribute__((target("avx2")))
+    void batch_addmodAVX2(const int * a, const int * b, int * out, size_t n, uint32_t modulus)
+    {
+	__m256i m = _mm256_set1_epi32(modulus);
+	size_t i = 0;
+	for(; i+8<=n; i+=8)
+	{
+	    __m256i s = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i)));
+	    _mm256_storeu_si256((__m256i *)(out+i), _mm256_min_epu32(s, _mm256_sub_epi32(s, m)));
+	}
+	for(; i<n; i++) out[i] = std::min((uint32_t)a[i]+b[i], (uint32_t)a[i]+b[i]-modulus);
+    }
+
+    __attribute__((target("avx2")))
+    void batch_mulmodAVX2(const int * a, const int * b, int * out, size_t n, const batch_Montgomery32 & mont)
+    {
+	__m256i m = _mm256_set1_epi32(mont.m), mInverse = _mm256_set1_epi32(mont.mInverse), r2 = _mm256_set1_epi32(mont.r2);
+	size_t i = 0;
+	for(; i+8<=n; i+=8)
+	{
+	    __m256i x = batch_montgomeryMulAVX2(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i)), m, mInverse);
+	    _mm256_storeu_si256((__m256i *)(out+i), batch_montgomeryMulAVX2(x, r2, m, mInverse));
+	}
+	for(; i<n; i++) out[i] = mont.mul(mont.mul(a[i], b[i]), mont.r2);
+    }
+
+    __attribute__((target("avx2")))
+    void batch_powmodAVX2(const int * bases, long exponent, int * out, size_t n, const batch_Montgomery32 & mont)
+    {
+	__m256i m = _mm256_set1_epi32(mont.m), mInverse = _mm256_set1_epi32(mont.mInverse);
+	__m256i r2 = _mm256_set1_epi32(mont.r2), one = _mm256_set1_epi32(mont.one), unit = _mm256_set1_epi32(1);
+	int top = 63-__builtin_clzll(exponent|1);
+	size_t i = 0;
+	for(; i+8<=n; i+=8)
+	{
+	    __m256i base = batch_montgomeryMulAVX2(_mm256_loadu_si256((const __m256i *)(bases+i)), r2, m, mInverse);
+	    __m256i ans = one;
+	    for(int bit=top; bit>=0; bit--)
+	    {
+		ans = batch_montgomeryMulAVX2(ans, ans, m, mInverse);
+		if((exponent>>bit)&1) ans = batch_montgomeryMulAVX2(ans, base, m, mInverse);
+	    }
+	    _mm256_storeu_si256((__m256i *)(out+i), batch_montgomeryMulAVX2(ans, unit, m, mInverse));
+	}
+	for(; i<n; i++) out[i] = mont.pow(bases[i], exponent);
+    }
+
+    // GCC 12 reports its own avx512fintrin.h as using uninitialized values
+    // in _mm512_mul_epu32 and _mm512_srli_epi64; the warning is spurious
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    __attribute__((target("avx512f")))
+    inline __m512i batch_montgomeryMulAVX512(__m512i a, __m512i b, __m512i m, __m512i mInverse)
+    {
+	__m512i tEven = _mm512_mul_epu32(a, b);
+	__m512i tOdd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+	__m512i qmEven = _mm512_mul_epu32(_mm512_mul_epu32(tEven, mInverse), m);
+	__m512i qmOdd = _mm512_mul_epu32(_mm512_mul_epu32(tOdd, mInverse), m);
+	__m512i tHigh = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(tEven, 32), tOdd);
+	__m512i qmHigh = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(qmEven, 32), qmOdd);
+	__m512i d = _mm512_sub_epi32(tHigh, qmHigh);
+	return _mm512_min_epu32(d, _mm512_add_epi32(d, m));
+    }
+
+    __attribute__((target("avx512f")))
+    void batch_addmodAVX512(const int * a, const int * b, int * out, size_t n, uint32_t modulus)
+    {
+	__m512i m = _mm512_set1_epi32(modulus);
+	size_t i = 0;
+	for(; i+16<=n; i+=16)
+	{
+	    __m512i s = _mm512_add_epi32(_mm512_loadu_si512(a+i), _mm512_loadu_si512(b+i));
+	    _mm512_storeu_si512(out+i, _mm512_min_epu32(s, _mm512_sub_epi32(s, m)));
+	}
+	for(; i<n; i++) out[i] = std::min((uint32_t)a[i]+b[i], (uint32_t)a[i]+b[i]-modulus);
+    }
+
+    __attribute__((target("avx512f")))
+    void batch_mulmodAVX512(const int * a, const int * b, int * out, size_t n, const batch_Montgomery32 & mont)
+    {
+	__m512i m = _mm512_set1_epi32(mont.m), mInverse = _mm512_set1_epi32(mont.mInverse), r2 = _mm512_set1_epi32(mont.r2);
+	size_t i = 0;
+	for(; i+16<=n; i+=16)
+	{
+	    __m512i x = batch_montgomeryMulAVX512(_mm512_loadu_si512(a+i), _mm512_loadu_si512(b+i), m, mInverse);
+	    _mm512_storeu_si512(out+i, batch_montgomeryMulAVX512(x, r2, m, mInverse));
+	}
+	for(; i<n; i++) out[i] = mont.mul(mont.mul(a[i], b[i]), mont.r2);
+    }
+
+    __attribute__((target("avx512f")))
+    void batch_powmodAVX512(const int * bases, long exponent, int * out, size_t n, const batch_Montgomery32 & mont)
+    {
+	__m512i m = _mm512_set1_epi32(mont.m), mInverse = _mm512_set1_epi32(mont.mInverse);
+	__m512i r2 = _mm512_set1_epi32(mont.r2), one = _mm512_set1_epi32(mont.one), unit = _mm512_set1_epi32(1);
+	int top = 63-__builtin_clzll(exponent|1);
+	size_t i = 0;
+	for(; i+16<=n; i+=16)
+	{
+	    __m512i base = batch_montgomeryMulAVX512(_mm512_loadu_si512(bases+i), r2, m, mInverse);
+	    __m512i ans = one;
+	    for(int bit=top; bit>=0; bit--)
+	    {
+		ans = batch_montgomeryMulAVX512(ans, ans, m, mInverse);
+		if((exponent>>bit)&1) ans = batch_montgomeryMulAVX512(ans, base, m, mInverse);
+	    }
+	    _mm512_storeu_si512(out+i, batch_montgomeryMulAVX512(ans, unit, m, mInverse));
+	}
+	for(; i<n; i++) out[i] = mont.pow(bases[i], exponent);
+    }
+#pragma GCC diagnostic pop
+#endif
+
+    // widest instruction set available: 2 for AVX-512, 1 for AVX2, 0 for none
+    int batch_simdLevel()
+    {
+#ifdef BR_MODARITH_SIMD
+	static const int level = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+	return level;
+#else
+	return 0;
+#endif
+    }
+
+    //Batch Modular Addition
+    void addmod(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out, int modulus)
+    {
+	out.resize(a.size());
+	if(modulus==0)
+	{
+	    std::fill(out.begin(), out.end(), -1);
+	    return;
+	}
+	uint32_t m = std::abs((long)modulus);
+#ifdef BR_MODARITH_SIMD
+	if(batch_simdLevel()==2) return batch_addmodAVX512(a.data(), b.data(), out.data(), a.size(), m);
+	if(batch_simdLevel()==1) return batch_addmodAVX2(a.data(), b.data(), out.data(), a.size(), m);
+#endif
+	for(size_t i=0; i<a.size(); i++)
+	{
+	    out[i] = std::min((uint32_t)a[i]+b[i], (uint32_t)a[i]+b[i]-m);
+	}
+    }
+
+    //Batch Modular Multiplication
+    void mulmod(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out, int modulus)
+    {
+	out.resize(a.size());
+	if(modulus==0)
+	{
+	    std::fill(out.begin(), out.end(), -1);
+	    return;
+	}
+	Modulus context(modulus);
+#ifdef BR_MODARITH_SIMD
+	if((context.value()&1) && batch_simdLevel()>0)
+	{
+	    batch_Montgomery32 mont(context.value());
+	    if(batch_simdLevel()==2) return batch_mulmodAVX512(a.data(), b.data(), out.data(), a.size(), mont);
+	    return batch_mulmodAVX2(a.data(), b.data(), out.data(), a.size(), mont);
+	}
+#endif
+	for(size_t i=0; i<a.size(); i++)
+	{
+	    out[i] = context.mul(a[i], b[i]);
+	}
+    }
+
+    //Batch Modular Exponentiation
+    void powmod(const std::vector<int> & bases, long exponent, std::vector<int> & out, int modulus)
+    {
+	out.resize(bases.size());
+	if(modulus==0)
+	{
+	    std::fill(out.begin(), out.end(), -1);
+	    return;
+	}
+	Modulus context(modulus);
+#ifdef BR_MODARITH_SIMD
+	if(exponent>0 && (context.value()&1) && batch_simdLevel()>0)
+	{
+	    batch_Montgomery32 mont(context.value());
+	    if(batch_simdLevel()==2) return batch_powmodAVX512(bases.data(), exponent, out.data(), bases.size(), mont);
+	    return batch_powmodAVX2(bases.data(), exponent, out.data(), bases.size(), mont);
+	}
+#endif
+	for(size_t i=0; i<bases.size(); i++)
+	{
+	    out[i] = context.pow(bases[i], exponent);
+	}
+    }
+
+    FactorialTable::FactorialTable(int n, int modulus) : n(std::max(n, 0)), valid(modulus!=0), m(modulus==0 ? 1 : modulus), invertible(-1)
+    {
+	if(!valid) return;
+	facts.resize(this->n+1);
+	facts[0] = m.reduce(1);
+	for(int k=1; k<=this->n; k++) facts[k] = m.mul(facts[k-1], m.reduce(k));
+
+	// the prime powers of m, by trial division
+	int rest = m.value();
+	for(int p=2; (long)p*p<=rest; p++)
+	{
+	    if(rest%p) continue;
+	    int e = 0, q = 1;
+	    while(rest%p==0)
+	    {
+		rest /= p;
+		q *= p;
+		e++;
+	    }
+	    primePowers.push_back(PrimePower(p, e, q));
+	}
+	if(rest>1) primePowers.push_back(PrimePower(rest, 1, rest));
+
+	// k! is invertible until k reaches the smallest prime of m
+	invertible = primePowers.empty() ? this->n : std::min(this->n, primePowers[0].p-1);
+	inverseFacts.resize(invertible+1);
+	inverseFacts[invertible] = m.reduce(m.inverse(facts[invertible]));
+	for(int k=invertible; k>0; k--) inverseFacts[k-1] = m.mul(inverseFacts[k], m.reduce(k));
+
+	// the prime power tables are useless if the direct route covers the
+	// whole table and some q is too big to go past it
+	bool fits = true;
+	for(size_t i=0; i<primePowers.size(); i++) fits = fits && (long)primePowers[i].q <= (long)this->n+1;
+	if(invertible==this->n && !fits) return;
+	for(size_t i=0; i<primePowers.size(); i++)
+	{
+	    PrimePower & pp = primePowers[i];
+	    int length = (int)std::min((long)pp.q, (long)this->n+1);
+	    pp.units.resize(length);
+	    pp.units[0] = pp.mod.reduce(1);
+	    for(int y=1; y<length; y++) pp.units[y] = y%pp.p ? pp.mod.mul(pp.units[y-1], y) : pp.units[y-1];
+	    int rest = m.value()/pp.q;
+	    pp.crt = (int)((long)rest * pp.mod.inverse(rest) % m.value());
+	}
+    }
+
+    int FactorialTable::factorial(long k) const
+    {
+	if(!valid || k<0 || k>n) return -1;
+	return facts[k];
+    }
+
+    int FactorialTable::inverseFactorial(long k) const
+    {
+	if(!valid || k<0 || k>invertible) return -1;
+	return inverseFacts[k];
+    }
+
+    int FactorialTable::binom(long n, long k) const
+    {
+	if(!valid) return -1;
+	if(k<0 || k>n) return 0;
+	if(n<=invertible) return m.mul(facts[n], m.mul(inverseFacts[k], inverseFacts[n-k]));
+	if(primePowers.empty()) return 0;
+
+	long ans = 0;
+	for(size_t i=0; i<primePowers.size(); i++)
+	{
+	    int r = binom_primePower(primePowers[i], n, k);
+	    if(r<0) return -1;
+	    ans = (ans + (long)r*primePowers[i].crt) % m.value();
+	}
+	return (int)ans;
+    }
+
+    //Binomial mod a prime power, by Granville's theorem
+    int FactorialTable::binom_primePower(const PrimePower & pp, long n, long k) const
+    {
+	long v = 0;
+	for(long a=n/pp.p, b=k/pp.p, c=(n-k)/pp.p; a>0; a/=pp.p, b/=pp.p, c/=pp.p) v += a-b-c;
+	if(v>=pp.e) return 0;
+
+	// y!_p mod q: (q-1)!_p is -1 or 1, and the rest repeats with period q
+	const std::vector<int> & units = pp.units;
+	auto unitFactorial = [&](long y) -> int
+	{
+	    long r = y%pp.q, wraps = y/pp.q;
+	    if(r>=(long)units.size() || (wraps>0 && (long)units.size()<pp.q)) return -1;
+	    if(wraps%2==1 && units[pp.q-1]==pp.q-1) return pp.q-units[r];
+	    return units[r];
+	};
+	int num = pp.mod.reduce(1), den = pp.mod.reduce(1);
+	for(long a=n, b=k, c=n-k; a>0; a/=pp.p, b/=pp.p, c/=pp.p)
+	{
+	    int ua = unitFactorial(a), ub = unitFactorial(b), uc = unitFactorial(c);
+	    if(ua<0 || ub<0 || uc<0) return -1;
+	    num = pp.mod.mul(num, ua);
+	    den = pp.mod.mul(den, pp.mod.mul(ub, uc));
+	}
+	int power = 1;
+	for(long i=0; i<v; i++) power *= pp.p;
+	return pp.mod.mul(pp.mod.mul(num, pp.mod.inverse(den)), power);
+    }
+
+    int FactorialTable::multinomial(const std::vector<long> & counts) const
+    {
+	if(!valid) return -1;
+	int ans = m.reduce(1);
+	long total = 0;
+	for(size_t i=0; i<counts.size(); i++)
+	{
+	    if(counts[i]<0) return 0;
+	    total += counts[i];
+	    int b = binom(total, counts[i]);
+	    if(b<0) return -1;
+	    ans = m.mul(ans, b);
+	}
+	return ans;
+    }
+
 }
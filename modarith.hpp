@@ -8,6 +8,9 @@
 #ifndef BR_MODARITH_HPP
 #define BR_MODARITH_HPP
 
+#include<vector>
+#include<cstdint>
+
 namespace nt
 {
     /**
@@ -20,6 +23,16 @@ namespace nt
     int gcd(int a, int b);   
     long gcd(long a, long b);
 
+    /**
+     * Binary Greatest Common Divisor
+     * PARAMETERS: two unsigned 64-bit integers
+     * RETURN: their greatest common divisor; 0 if both are 0
+     * Notes: Stein's algorithm, with no division, over the full unsigned
+     * range.  gcd is built on it, and the 64-bit steps of Lehmer's gcd and
+     * Pollard's rho use it directly.
+     */
+    uint64_t binaryGcd(uint64_t a, uint64_t b);
+
     /**
      * Least Common Multiple
      * PARAMETERS: two integers (ints)
@@ -51,14 +64,55 @@ namespace nt
      * Modular Factorial
      * PARAMETERS: the number n to be factorialed, and the modulus, as int
      * RETURN: n! modulo the modulus, as int
-     * Notes: If you need to compute with many factorials, use a table instead.
-     * This function is for one-off uses.  Modulus is converted to its absolute
+     * Notes: If you need to compute with many factorials, use a FactorialTable
+     * instead.  This function is for one-off uses.  Modulus is converted to its absolute
      * value before computation.  Since negative factorials are not defined,
      * the return value is -1 if n is negative.  Similarly if modulus is 0.
-     * Runtime is O(min(n, modulus))
+     * Runtime is O(min(n, modulus)), except that large n modulo a prime go
+     * through factmodPrime.
      */
     int factmod(int n, int modulus);
 
+    /**
+     * Modular Factorial, for a prime modulus
+     * PARAMETERS: the number n to be factorialed (long), and a prime p (int)
+     * RETURN: n! modulo p
+     * Notes: Uses min_25's method: with v = sqrt(n), the values of
+     * g(x) = (vx+1)(vx+2)...(vx+v) at x = 0, ..., v-1 multiply to (v^2)!, and
+     * they are found by doubling the degree of g, shifting its sample points
+     * with NTT convolutions (see shiftSamples in ntt.hpp).  n > p/2 is first
+     * reduced to p-1-n by Wilson's theorem.  Runtime is O(sqrt(p) log(p)):
+     * about 30ms for p near 10^9.  Returns 0 if n >= p, and -1 if n is
+     * negative or p < 2.  If p is not prime, behavior is undefined.
+     */
+    int factmodPrime(long n, int p);
+
+    /**
+     * Modular Factorial, without the factors of p
+     * PARAMETERS: the number n to be factorialed (long), a prime p (int), and
+     * a long (exponent) to hold the power of p in n!
+     * RETURN: n!/p^exponent modulo p, where exponent is given by Legendre's
+     * formula, n/p + n/p^2 + ...
+     * Notes: Since (p-1)! = -1 mod p (Wilson), the integers up to n that are
+     * prime to p contribute (-1)^(n/p) * (n mod p)!, and the multiples of p
+     * contribute p^(n/p) * (n/p)!, so this takes one factmodPrime per digit
+     * of n in base p.  Returns -1 if n is negative or p < 2.
+     */
+    int factmodPrime(long n, int p, long & exponent);
+
+    /**
+     * Batch Modular Factorial, for a prime modulus
+     * PARAMETERS: a vector (values) of the numbers to be factorialed, a prime
+     * p, and a vector (out) to hold the results.
+     * RETURN: Nothing, but out[i] = values[i]! modulo p, as in factmodPrime.
+     * Notes: This function changes the vector parameter!  The products of the
+     * blocks of about sqrt(p/2) consecutive integers are found once, so each
+     * factorial after that is one prefix product times at most sqrt(p/2)
+     * multiplications: thousands of factorials modulo a prime near 10^9 take
+     * a fraction of a second.
+     */
+    void factmodPrime(const std::vector<long> & values, int p, std::vector<int> & out);
+
 
     /**
      * Modular Inverse
@@ -86,6 +140,158 @@ namespace nt
     long solveModularSystem(int a, int firstModulus, int b, int secondModulus);
 
 
+    /**
+     * Modulus Context
+     * Precomputes Barrett reduction constants for one modulus, so that
+     * repeated arithmetic against that modulus needs no division: each
+     * reduction is two multiplications, two shifts and at most two
+     * subtractions.  Use it instead of the free functions when doing many
+     * operations with the same modulus.
+     *
+     * CONSTRUCTOR PARAMETERS: the modulus, as int
+     * Notes: the modulus is converted to its absolute value, and must not be
+     * 0.  Apart from reduce, pow and inverse, all arguments must already be
+     * reduced, i.e. lie in [0, modulus).  The batch versions resize their
+     * output vector to the size of their input.
+     */
+    class Modulus
+    {
+    public:
+	explicit Modulus(int modulus);
+
+	// the modulus
+	int value() const { return (int)m; }
+
+	// a mod m, in [0, m)
+	int reduce(long a) const;
+
+	// a*b mod m
+	int mul(int a, int b) const
+	{
+	    uint64_t x = (uint64_t)a*(uint32_t)b;
+	    uint64_t q = ((x >> (shift-1))*mu) >> (shift+1);
+	    x -= q*m;
+	    while(x>=m) x -= m;
+	    return (int)x;
+	}
+
+	// base^exponent mod m, with the conventions of powmod
+	int pow(long base, long exponent) const;
+
+	// the inverse of a mod m, with the conventions of modularInverse
+	int inverse(long a) const;
+
+	// out[i] = a[i]*b[i] mod m
+	void mul(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out) const;
+
+	// out[i] = bases[i]^exponent mod m, with the conventions of powmod
+	void pow(const std::vector<int> & bases, long exponent, std::vector<int> & out) const;
+
+    private:
+	// m has (shift) bits, and mu = floor(4^shift / m)
+	uint64_t m, mu;
+	int shift;
+    };
+
+
+    /**
+     * Batch Modular Arithmetic
+     * Element-wise modular addition, multiplication and exponentiation over
+     * whole arrays of residues: out[i] = a[i]+b[i], a[i]*b[i] or
+     * bases[i]^exponent, modulo the modulus.
+     * For an odd modulus these run Montgomery multiplication in SIMD lanes,
+     * 16 at a time with AVX-512 or 8 at a time with AVX2, whichever the CPU
+     * supports (checked at run time); otherwise, and for even moduli, they
+     * fall back to scalar Barrett reduction.
+     *
+     * PARAMETERS: the input vectors, a vector (out) to hold the results, and
+     * the modulus, as int
+     * RETURN: Nothing, but out is resized to the size of the first input and
+     * holds the results, in [0, modulus), except that a zero exponent gives
+     * 1 even modulo 1, as in powmod.
+     * Notes: This function changes the vector parameter!  The inputs must
+     * already be reduced, i.e. lie in [0, modulus), and b must be at least as
+     * long as a.  The modulus is converted to its absolute value; if it is 0,
+     * every result is -1.  A negative exponent follows the conventions of
+     * powmod, but is handled one element at a time.
+     */
+    void addmod(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out, int modulus);
+    void mulmod(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out, int modulus);
+    void powmod(const std::vector<int> & bases, long exponent, std::vector<int> & out, int modulus);
+
+
+    /**
+     * Factorial Table
+     * Factorials and inverse factorials modulo a fixed modulus m, for O(1)
+     * binomial coefficients.  The inverse factorials take a single modular
+     * inverse, of the largest invertible factorial, and a backward sweep
+     * (1/(k-1)! = k * 1/k!).
+     * Binomials that the table cannot do directly, with n beyond the table or
+     * with k! not invertible mod m, go through the prime powers q = p^e of m:
+     * by Legendre's formula and Granville's generalization of Lucas' theorem,
+     *     C(n, k) = p^v * U(n) / (U(k) U(n-k))  (mod q),
+     * where v counts the carries in k + (n-k) in base p, U(x) is the product
+     * of (x/p^i)!_p over i, and y!_p, the product of the integers up to y
+     * prime to p, is periodic mod q up to a sign.  The results for each q are
+     * combined by the Chinese remainder theorem.
+     *
+     * CONSTRUCTOR PARAMETERS: the size (n) of the table and the modulus, as
+     * ints.
+     * Notes: the modulus is converted to its absolute value.  factorial and
+     * inverseFactorial answer for 0 <= k <= n, and return -1 beyond the table,
+     * or (inverseFactorial) when k! is not invertible; binom and multinomial
+     * return 0 for impossible choices.  The prime power route needs a table
+     * of y!_p for y < min(q, n+1), so it answers for any n when every q is
+     * at most n+1, and returns -1 when it would need a value past that table.
+     * If the modulus is 0, everything returns -1.  Memory is about 8 bytes per
+     * entry, plus 4 per entry and prime power if the prime power route is
+     * used.
+     */
+    class FactorialTable
+    {
+    public:
+	FactorialTable(int n, int modulus);
+
+	// the size of the table
+	int size() const { return n; }
+
+	// the modulus
+	int modulus() const { return m.value(); }
+
+	// k! mod m
+	int factorial(long k) const;
+
+	// 1/k! mod m
+	int inverseFactorial(long k) const;
+
+	// n choose k mod m
+	int binom(long n, long k) const;
+
+	// (k1+k2+...)! / (k1! k2! ...) mod m
+	int multinomial(const std::vector<long> & counts) const;
+
+    private:
+	struct PrimePower
+	{
+	    int p, e, q;
+	    Modulus mod;
+	    std::vector<int> units; // units[y] = y!_p mod q
+	    int crt; // 1 mod q and 0 mod m/q, mod m
+	    PrimePower(int p, int e, int q) : p(p), e(e), q(q), mod(q), crt(0) {}
+	};
+
+	int binom_primePower(const PrimePower & pp, long n, long k) const;
+
+	int n;
+	bool valid;
+	Modulus m;
+	// inverseFacts covers 0..invertible, the k with k! invertible mod m
+	int invertible;
+	std::vector<int> facts, inverseFacts;
+	std::vector<PrimePower> primePowers;
+    };
+
+
 
 
 }
@@ -1,26 +1,153 @@
 // implementation of high precision modular arithmetic functions
 
 #include "numthy/modarithx.hpp"
+#include "numthy/modarith.hpp"
+#include<algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include<immintrin.h>
+#define BR_MODARITHX_SIMD
+#endif
 
 using namespace boost::multiprecision;
 
 namespace nt
 {
-    //Greatest Common Divisor
+    //Greatest Common Divisor, by Lehmer's algorithm: the quotients of the
+    //Euclidean algorithm are mostly determined by the leading 62 bits of a
+    //and b, so as many steps as possible are simulated on those in single
+    //precision, and then applied to a and b at once as a 2x2 matrix
     cpp_int gcd(cpp_int a, cpp_int b)
     {
-	cpp_int temp;
 	a = abs(a);
 	b = abs(b);
+	if(a<b) a.swap(b);
 
-	while(b>0)
+	cpp_int temp;
+	while(b>0 && msb(a)>=64)
 	{
-	    temp = b;
-	    b = a%b;
-	    a = temp;
+	    unsigned shift = msb(a)-61;
+	    long ah = (long)static_cast<uint64_t>(a >> shift);
+	    long bh = (long)static_cast<uint64_t>(b >> shift);
+	    // the cofactors: a' = A*a + B*b, b' = C*a + D*b
+	    long A = 1, B = 0, C = 0, D = 1;
+	    while(bh+C!=0 && bh+D!=0)
+	    {
+		long q = (ah+A)/(bh+C);
+		if(q != (ah+B)/(bh+D)) break;
+		long t = A-q*C; A = C; C = t;
+		t = B-q*D; B = D; D = t;
+		t = ah-q*bh; ah = bh; bh = t;
+	    }
+	    if(B==0)
+	    {
+		// not even one quotient was certain: do a full division step
+		temp = a%b;
+		a.swap(b);
+		b.swap(temp);
+	    }
+	    else
+	    {
+		temp = A*a + B*b;
+		b = C*a + D*b;
+		a.swap(temp);
+	    }
+	}
+	if(b==0) return a;
+	// both fit in 64 bits now
+	return binaryGcd(static_cast<uint64_t>(a%b), static_cast<uint64_t>(b));
+    }
+
+    /* Batch Greatest Common Divisor
+     * The top levels of the remainder tree divide numbers of millions of
+     * bits, where the schoolbook division of cpp_int would make the whole
+     * thing quadratic.  Instead every node gets a reciprocal, computed by
+     * Newton's iteration, and reductions are done with Barrett's method, so
+     * that only (Karatsuba) multiplications are needed.
+     */
+    const unsigned BATCH_GCD_DIVISION_BITS = 4096;
+
+    // floor(4^k / d), for 2^(k-1) <= d < 2^k: the reciprocal of the leading
+    // half of d is refined by one Newton step, x = 2x - d*x^2/4^k
+    cpp_int gcd_reciprocal(const cpp_int & d, unsigned k)
+    {
+	if(k<=BATCH_GCD_DIVISION_BITS) return (cpp_int(1) << (2*k)) / d;
+	unsigned h = k/2+4;
+	cpp_int x = gcd_reciprocal(d >> (k-h), h) << (k-h);
+	x = (x << 1) - ((d*x*x) >> (2*k));
+	// x is now off by a few units at most
+	cpp_int r = (cpp_int(1) << (2*k)) - d*x;
+	while(r<0)
+	{
+	    x--;
+	    r += d;
+	}
+	while(r>=d)
+	{
+	    x++;
+	    r -= d;
+	}
+	return x;
+    }
+
+    // a mod d, for 2^(k-1) <= d < 2^k, and mu = gcd_reciprocal(d, k).  Each
+    // Barrett step takes care of the top 2k bits of a.
+    cpp_int gcd_reduce(cpp_int a, const cpp_int & d, const cpp_int & mu, unsigned k)
+    {
+	if(k<=BATCH_GCD_DIVISION_BITS) return a % d;
+	while(a>=d)
+	{
+	    unsigned bits = msb(a)+1, low = bits>2*k ? bits-2*k : 0;
+	    cpp_int top = a >> low;
+	    top -= (((top >> (k-1))*mu) >> (k+1))*d;
+	    while(top>=d) top -= d;
+	    a = (top << low) | (a & ((cpp_int(1) << low) - 1));
 	}
 	return a;
-}
+    }
+
+    //Batch Greatest Common Divisor
+    void gcd(const std::vector<cpp_int> & values, std::vector<cpp_int> & out)
+    {
+	out.resize(values.size());
+	if(values.empty()) return;
+
+	// tree[0] holds the values, tree[k+1][j] = tree[k][2j]*tree[k][2j+1]
+	std::vector<std::vector<cpp_int> > tree(1, std::vector<cpp_int>(values.size()));
+	for(size_t i=0; i<values.size(); i++)
+	{
+	    tree[0][i] = values[i]==0 ? cpp_int(1) : cpp_int(abs(values[i]));
+	}
+	while(tree.back().size()>1)
+	{
+	    const std::vector<cpp_int> & below = tree.back();
+	    std::vector<cpp_int> above((below.size()+1)/2);
+	    for(size_t j=0; j<above.size(); j++)
+	    {
+		above[j] = 2*j+1<below.size() ? cpp_int(below[2*j]*below[2*j+1]) : below[2*j];
+	    }
+	    tree.push_back(std::move(above));
+	}
+
+	// remainders[j] = P mod tree[k][j]^2, from the root down
+	std::vector<cpp_int> remainders(1, tree.back()[0]), next;
+	for(size_t k=tree.size()-1; k-->0; )
+	{
+	    next.resize(tree[k].size());
+	    for(size_t j=0; j<next.size(); j++)
+	    {
+		cpp_int square = tree[k][j]*tree[k][j];
+		unsigned bits = msb(square)+1;
+		cpp_int mu = bits>BATCH_GCD_DIVISION_BITS ? gcd_reciprocal(square, bits) : cpp_int(0);
+		next[j] = gcd_reduce(remainders[j/2], square, mu, bits);
+	    }
+	    remainders.swap(next);
+	}
+	for(size_t i=0; i<values.size(); i++)
+	{
+	    out[i] = values[i]==0 ? cpp_int(0) : gcd(remainders[i]/tree[0][i], tree[0][i]);
+	}
+    }
 
     //Least Common Multiple
     cpp_int lcm(cpp_int a, cpp_int b)
@@ -33,46 +160,48 @@ namespace nt
     //Fast Modular Exponentiation
     long powmod(long base, long exponent, long modulus)
     {
-	modulus = abs(modulus);
-	int128_t ans = 1;
-	int128_t aux = (base % modulus);
-	if(aux<0) aux += modulus;
+	if(modulus==0) return -1;
+	if(exponent==0) return 1;
+	Modulus64 context(abs(modulus));
+	uint64_t aux = context.reduce(base);
 
 	if(exponent < 0)
 	{
-	    aux = (int128_t)modularInverse(aux, modulus);
+	    aux = context.inverse(aux);
 	    if(aux==0) return -1;
 	    exponent = -exponent;
 	}
-	
-	while(exponent>0)
-	{
-	    if(exponent&1) ans = (ans * aux) % modulus;
-	    exponent >>= 1;
-	    aux = (aux * aux) % modulus;
-	}
-	return (long)ans;
+	return (long)context.pow(aux, exponent);
     }
-    cpp_int powmod(cpp_int base, cpp_int exponent, cpp_int modulus)
+    cpp_int powmod(const cpp_int & base, const cpp_int & exponent, const cpp_int & modulus)
     {
 	if(modulus==0) return -1;
-	modulus = abs(modulus);
+	cpp_int m = abs(modulus);
+	if(m>1 && bit_test(m, 0))
+	{
+	    thread_local std::vector<uint64_t> scratch;
+	    cpp_int ans;
+	    BigModulus(m).pow(base, exponent, ans, scratch);
+	    return ans;
+	}
+
 	cpp_int ans = 1;
-	cpp_int aux = (base % modulus);
-	if(aux<0) aux += modulus;
+	cpp_int aux = (base % m);
+	if(aux<0) aux += m;
+	cpp_int e = exponent;
 
-	if(exponent < 0)
+	if(e < 0)
 	{
-	    aux = modularInverse(aux, modulus);
+	    aux = modularInverse(aux, m);
 	    if(aux==0) return -1;
-	    exponent = -exponent;
+	    e = -e;
 	}
 	
-	while(exponent>0)
+	while(e>0)
 	{
-	    if(exponent&1) ans = (ans * aux) % modulus;
-	    exponent >>= 1;
-	    aux = (aux * aux) % modulus;
+	    if(e&1) ans = (ans * aux) % m;
+	    e >>= 1;
+	    aux = (aux * aux) % m;
 	}
 	return ans;
     }
@@ -149,4 +278,676 @@ namespace nt
 	
 
     
+
+    //64-bit Modulus Context, using Montgomery reduction
+    Modulus64::Modulus64(uint64_t modulus) : m(modulus), mInverse(0), one(0), r2(0)
+    {
+	if(m&1)
+	{
+	    // m^-1 mod 2^64 by Newton's iteration; each step doubles the
+	    // number of correct low bits, starting from 3 (m*m = 1 mod 8)
+	    mInverse = m;
+	    for(int i=0; i<5; i++) mInverse *= 2-m*mInverse;
+	    one = (-m) % m;
+	    r2 = (unsigned __int128)one*one % m;
+	}
+    }
+
+    uint64_t Modulus64::reduce(long a) const
+    {
+	if(a>=0) return (uint64_t)a % m;
+	uint64_t r = (uint64_t)(-(a+1)) % m; // -(a+1) cannot overflow
+	return r==m-1 ? 0 : m-1-r;
+    }
+
+    uint64_t Modulus64::pow(uint64_t base, uint64_t exponent) const
+    {
+	if(exponent==0) return 1;
+	if(m&1) return fromMontgomery(montgomeryPow(toMontgomery(base), exponent));
+
+	uint64_t ans = 1 % m;
+	while(exponent>0)
+	{
+	    if(exponent&1) ans = mul(ans, base);
+	    exponent >>= 1;
+	    base = mul(base, base);
+	}
+	return ans;
+    }
+
+    uint64_t Modulus64::montgomeryPow(uint64_t a, uint64_t exponent) const
+    {
+	uint64_t ans = one;
+	while(exponent>0)
+	{
+	    if(exponent&1) ans = montgomeryMul(ans, a);
+	    exponent >>= 1;
+	    a = montgomeryMul(a, a);
+	}
+	return ans;
+    }
+
+    // Extended Euclidean Algorithm; the coefficients stay below m in
+    // absolute value, so they fit in 128 bits for any 64-bit modulus
+    uint64_t Modulus64::inverse(uint64_t a) const
+    {
+	if(m==1) return 1;
+	a %= m;
+	uint64_t b = m, quot, temp;
+	__int128 s = 1, t = 0, stemp; //will eventually solve a*s+m*t = 1
+
+	while(b>0)
+	{
+	    quot = a/b;
+
+	    temp = b;
+	    b = a-b*quot;
+	    a = temp;
+
+	    stemp = t;
+	    t = s - (__int128)quot * t;
+	    s = stemp;
+	}
+	if(a!=1) return 0; // gcd is not 1, no inverse
+
+	if(s < 0) s += m;
+	return (uint64_t)s;
+    }
+
+    void Modulus64::mul(const std::vector<uint64_t> & a, const std::vector<uint64_t> & b, std::vector<uint64_t> & out) const
+    {
+	out.resize(a.size());
+	if(!(m&1))
+	{
+	    for(size_t i=0; i<a.size(); i++) out[i] = mul(a[i], b[i]);
+	    return;
+	}
+	// (a*b*R^-1) * (R^2) * R^-1 = a*b
+	for(size_t i=0; i<a.size(); i++)
+	{
+	    out[i] = montgomeryMul(montgomeryMul(a[i], b[i]), r2);
+	}
+    }
+
+    void Modulus64::pow(const std::vector<uint64_t> & bases, uint64_t exponent, std::vector<uint64_t> & out) const
+    {
+	powmod(bases, exponent, out, m);
+    }
+
+    /* Batch Modular Arithmetic
+     * For odd moduli the AVX-512 kernel does Montgomery multiplication in the
+     * eight 64-bit lanes of a register.  There is no 64x64->128 bit vector
+     * multiplication, so the products are assembled from 32x32->64 bit
+     * ones: four for a full product, three when only its low half is needed.
+     * That only pays off for exponentiation, which is bound by the
+     * multiplier; a single multiplication or addition per element is bound
+     * by memory, and the scalar loop is as fast there.
+     */
+#ifdef BR_MODARITHX_SIMD
+    // m^-1 mod 2^64, for odd m, by Newton's iteration
+    uint64_t batch_montgomeryInverse(uint64_t m)
+    {
+	uint64_t inverse = m;
+	for(int i=0; i<5; i++) inverse *= 2-m*inverse;
+	return inverse;
+    }
+
+    // GCC 12 reports its own avx512fintrin.h as using uninitialized values
+    // in _mm512_mul_epu32 and _mm512_srli_epi64; the warning is spurious
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    // the 128-bit products a*b, split into their low and high halves
+    __attribute__((target("avx512f")))
+    inline void batch_mulWideAVX512(__m512i a, __m512i b, __m512i & low, __m512i & high)
+    {
+	__m512i mask = _mm512_set1_epi64(0xFFFFFFFF);
+	__m512i aHigh = _mm512_srli_epi64(a, 32), bHigh = _mm512_srli_epi64(b, 32);
+	__m512i ll = _mm512_mul_epu32(a, b), lh = _mm512_mul_epu32(a, bHigh);
+	__m512i hl = _mm512_mul_epu32(aHigh, b), hh = _mm512_mul_epu32(aHigh, bHigh);
+	__m512i middle = _mm512_add_epi64(_mm512_srli_epi64(ll, 32), _mm512_add_epi64(_mm512_and_si512(lh, mask), _mm512_and_si512(hl, mask)));
+	low = _mm512_or_si512(_mm512_and_si512(ll, mask), _mm512_slli_epi64(middle, 32));
+	high = _mm512_add_epi64(_mm512_add_epi64(hh, _mm512_srli_epi64(middle, 32)), _mm512_add_epi64(_mm512_srli_epi64(lh, 32), _mm512_srli_epi64(hl, 32)));
+    }
+
+    // a*b*R^-1 mod m in each lane
+    __attribute__((target("avx512f")))
+    inline __m512i batch_montgomeryMulAVX512(__m512i a, __m512i b, __m512i m, __m512i mInverse)
+    {
+	__m512i low, high, qmLow, qmHigh;
+	batch_mulWideAVX512(a, b, low, high);
+	// q = low*mInverse mod R
+	__m512i cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(low, 32), mInverse), _mm512_mul_epu32(low, _mm512_srli_epi64(mInverse, 32)));
+	__m512i q = _mm512_add_epi64(_mm512_mul_epu32(low, mInverse), _mm512_slli_epi64(cross, 32));
+	batch_mulWideAVX512(q, m, qmLow, qmHigh);
+	__m512i d = _mm512_sub_epi64(high, qmHigh);
+	return _mm512_mask_add_epi64(d, _mm512_cmplt_epu64_mask(high, qmHigh), d, m);
+    }
+
+    __attribute__((target("avx512f")))
+    void batch_powmodAVX512(const uint64_t * bases, uint64_t exponent, uint64_t * out, size_t n, const Modulus64 & context, uint64_t mInverse)
+    {
+	__m512i m = _mm512_set1_epi64(context.value()), inv = _mm512_set1_epi64(mInverse);
+	__m512i r2 = _mm512_set1_epi64(context.toMontgomery(context.montgomeryOne()));
+	__m512i one = _mm512_set1_epi64(context.montgomeryOne()), unit = _mm512_set1_epi64(1);
+	int top = 63-__builtin_clzll(exponent|1);
+	size_t i = 0;
+	for(; i+8<=n; i+=8)
+	{
+	    __m512i base = batch_montgomeryMulAVX512(_mm512_loadu_si512(bases+i), r2, m, inv);
+	    __m512i ans = one;
+	    for(int bit=top; bit>=0; bit--)
+	    {
+		ans = batch_montgomeryMulAVX512(ans, ans, m, inv);
+		if((exponent>>bit)&1) ans = batch_montgomeryMulAVX512(ans, base, m, inv);
+	    }
+	    _mm512_storeu_si512(out+i, batch_montgomeryMulAVX512(ans, unit, m, inv));
+	}
+	for(; i<n; i++) out[i] = context.pow(bases[i], exponent);
+    }
+#pragma GCC diagnostic pop
+
+    bool batch_hasAVX512()
+    {
+	static const bool supported = __builtin_cpu_supports("avx512f");
+	return supported;
+    }
+#endif
+
+    //Batch Modular Addition
+    void addmod(const std::vector<uint64_t> & a, const std::vector<uint64_t> & b, std::vector<uint64_t> & out, uint64_t modulus)
+    {
+	out.resize(a.size());
+	if(modulus==0)
+	{
+	    std::fill(out.begin(), out.end(), 0);
+	    return;
+	}
+	Modulus64 context(modulus);
+	for(size_t i=0; i<a.size(); i++)
+	{
+	    out[i] = context.add(a[i], b[i]);
+	}
+    }
+
+    //Batch Modular Multiplication
+    void mulmod(const std::vector<uint64_t> & a, const std::vector<uint64_t> & b, std::vector<uint64_t> & out, uint64_t modulus)
+    {
+	out.resize(a.size());
+	if(modulus==0)
+	{
+	    std::fill(out.begin(), out.end(), 0);
+	    return;
+	}
+	Modulus64 context(modulus);
+	for(size_t i=0; i<a.size(); i++)
+	{
+	    out[i] = context.mul(a[i], b[i]);
+	}
+    }
+
+    //Batch Modular Exponentiation
+    void powmod(const std::vector<uint64_t> & bases, uint64_t exponent, std::vector<uint64_t> & out, uint64_t modulus)
+    {
+	out.resize(bases.size());
+	if(modulus==0)
+	{
+	    std::fill(out.begin(), out.end(), 0);
+	    return;
+	}
+	Modulus64 context(modulus);
+#ifdef BR_MODARITHX_SIMD
+	if(exponent>0 && (modulus&1) && batch_hasAVX512())
+	{
+	    return batch_powmodAVX512(bases.data(), exponent, out.data(), bases.size(), context, batch_montgomeryInverse(modulus));
+	}
+#endif
+	for(size_t i=0; i<bases.size(); i++)
+	{
+	    out[i] = context.pow(bases[i], exponent);
+	}
+    }
+
+    /* Batch Modular Inverse
+     * out[lo, hi) holds the residues to be inverted.  If the product of the
+     * range is invertible, its inverse is peeled apart into the inverses of
+     * the single residues; otherwise the range is split in two, until the
+     * residues with no inverse are isolated.  The ring supplies mul, and
+     * inverse returning 0 when there is none.
+     */
+    template<class T, class Ring>
+    void modularInverse_range(std::vector<T> & out, size_t lo, size_t hi, const Ring & ring, std::vector<T> & prefix)
+    {
+	// prefix[i] = out[lo]*out[lo+1]*...*out[i]
+	prefix[lo] = out[lo];
+	for(size_t i=lo+1; i<hi; i++)
+	{
+	    prefix[i] = ring.mul(prefix[i-1], out[i]);
+	}
+	T inverse = ring.inverse(prefix[hi-1]);
+	if(inverse==0)
+	{
+	    if(hi-lo==1)
+	    {
+		out[lo] = 0;
+		return;
+	    }
+	    size_t mid = lo+(hi-lo)/2;
+	    modularInverse_range(out, lo, mid, ring, prefix);
+	    modularInverse_range(out, mid, hi, ring, prefix);
+	    return;
+	}
+	// inverse = (out[lo]*...*out[i])^-1 at the start of each step
+	for(size_t i=hi-1; i>lo; i--)
+	{
+	    T value = out[i];
+	    out[i] = ring.mul(inverse, prefix[i-1]);
+	    inverse = ring.mul(inverse, value);
+	}
+	out[lo] = inverse;
+    }
+
+    struct modularInverse_BigRing
+    {
+	cpp_int m;
+	cpp_int mul(const cpp_int & a, const cpp_int & b) const { return a*b%m; }
+	cpp_int inverse(const cpp_int & a) const { return modularInverse(a, m); }
+    };
+
+    //Batch Modular Inverse
+    void modularInverse(const std::vector<long> & values, std::vector<long> & out, long modulus)
+    {
+	out.resize(values.size());
+	modulus = std::abs(modulus);
+	if(modulus<=1)
+	{
+	    std::fill(out.begin(), out.end(), modulus);
+	    return;
+	}
+	std::vector<uint64_t> residues(values.size()), prefix(values.size());
+	for(size_t i=0; i<values.size(); i++)
+	{
+	    residues[i] = values[i]%modulus + (values[i]%modulus<0 ? modulus : 0);
+	}
+	if(!residues.empty()) modularInverse_range(residues, 0, residues.size(), Modulus64(modulus), prefix);
+	for(size_t i=0; i<values.size(); i++)
+	{
+	    out[i] = (long)residues[i];
+	}
+    }
+
+    void modularInverse(const std::vector<cpp_int> & values, std::vector<cpp_int> & out, cpp_int modulus)
+    {
+	modulus = abs(modulus);
+	if(modulus<=1)
+	{
+	    out.assign(values.size(), modulus);
+	    return;
+	}
+	out.resize(values.size());
+	for(size_t i=0; i<values.size(); i++)
+	{
+	    out[i] = values[i]%modulus;
+	    if(out[i]<0) out[i] += modulus;
+	}
+	std::vector<cpp_int> prefix(values.size());
+	modularInverse_BigRing ring = {modulus};
+	if(!out.empty()) modularInverse_range(out, 0, out.size(), ring, prefix);
+    }
+
+    //System of k Congruences Solver
+    cpp_int solveModularSystem(const std::vector<long> & residues, const std::vector<long> & moduli)
+    {
+	return ChineseRemainder(moduli).solve(residues);
+    }
+
+    cpp_int solveModularSystem(const std::vector<cpp_int> & residues, const std::vector<cpp_int> & moduli)
+    {
+	std::vector<cpp_int> a(residues), m(moduli);
+	for(size_t i=0; i<m.size(); i++)
+	{
+	    if(m[i]==0) return -1;
+	    m[i] = abs(m[i]);
+	}
+	if(m.empty()) return 0;
+
+	// merge neighbours, halving the number of congruences each round
+	while(m.size()>1)
+	{
+	    size_t half = (m.size()+1)/2;
+	    for(size_t j=0; j<half; j++)
+	    {
+		if(2*j+1==m.size())
+		{
+		    a[j] = a[2*j];
+		    m[j] = m[2*j];
+		    continue;
+		}
+		a[j] = solveModularSystem(a[2*j], m[2*j], a[2*j+1], m[2*j+1]);
+		if(a[j]<0) return -1;
+		m[j] = lcm(m[2*j], m[2*j+1]);
+	    }
+	    a.resize(half);
+	    m.resize(half);
+	}
+	a[0] %= m[0];
+	if(a[0]<0) a[0] += m[0];
+	return a[0];
+    }
+
+    //Chinese Remainder Context
+    ChineseRemainder::ChineseRemainder(const std::vector<long> & moduli) : moduli(moduli), lcm(1), isCoprime(true)
+    {
+	size_t k = moduli.size();
+	for(size_t i=0; i<k; i++)
+	{
+	    this->moduli[i] = std::abs(moduli[i]);
+	    if(moduli[i]==0)
+	    {
+		lcm = 0;
+		isCoprime = false;
+		return;
+	    }
+	}
+
+	contexts.reserve(k);
+	inverses.resize(k);
+	radices.resize(k*k);
+	for(size_t i=0; i<k; i++)
+	{
+	    contexts.push_back(Modulus64(this->moduli[i]));
+	    const Modulus64 & context = contexts[i];
+	    uint64_t product = context.reduce(1);
+	    for(size_t j=0; j<i; j++)
+	    {
+		radices[i*k+j] = product;
+		product = context.mul(product, context.reduce(this->moduli[j]));
+	    }
+	    inverses[i] = context.inverse(product);
+	    if(inverses[i]==0 && this->moduli[i]>1) isCoprime = false;
+	}
+
+	if(isCoprime)
+	{
+	    for(size_t i=0; i<k; i++) lcm *= this->moduli[i];
+	}
+	else
+	{
+	    std::vector<cpp_int> m(this->moduli.begin(), this->moduli.end());
+	    while(m.size()>1)
+	    {
+		for(size_t j=0; j<m.size()/2; j++)
+		{
+		    m[j] = nt::lcm(m[2*j], m[2*j+1]);
+		}
+		if(m.size()&1) m[m.size()/2] = m.back();
+		m.resize((m.size()+1)/2);
+	    }
+	    if(!m.empty()) lcm = m[0];
+	}
+    }
+
+    cpp_int ChineseRemainder::solve(const std::vector<long> & residues) const
+    {
+	if(lcm==0) return -1;
+	size_t k = moduli.size();
+	if(!isCoprime)
+	{
+	    std::vector<cpp_int> a(residues.begin(), residues.end()), m(moduli.begin(), moduli.end());
+	    return solveModularSystem(a, m);
+	}
+
+	// the mixed radix digits: vi = (ri - (v0 + v1*m0 + ...)) / (m0*...*m(i-1)) mod mi
+	// A digit vj < mj need not be reduced mod mi to be multiplied by the
+	// reduced radix: the product is below 2^64*mi, which is all the
+	// Montgomery reduction requires.
+	std::vector<uint64_t> digits(k);
+	for(size_t i=0; i<k; i++)
+	{
+	    const Modulus64 & context = contexts[i];
+	    uint64_t sum = 0;
+	    for(size_t j=0; j<i; j++)
+	    {
+		sum = context.add(sum, context.mul(digits[j], radices[i*k+j]));
+	    }
+	    digits[i] = context.mul(context.sub(context.reduce(residues[i]), sum), inverses[i]);
+	}
+
+	cpp_int ans = 0;
+	for(size_t i=k; i-->0; )
+	{
+	    ans *= moduli[i];
+	    ans += digits[i];
+	}
+	return ans;
+    }
+
+    //Big Modulus Context, using Montgomery reduction on the limbs of cpp_int
+    static_assert(sizeof(limb_type)==sizeof(uint64_t), "BigModulus needs 64-bit limbs");
+
+    BigModulus::BigModulus(const cpp_int & modulus) : m(abs(modulus)), mInverse(0), n((int)m.backend().size())
+    {
+	if(!bit_test(m, 0) || m==1) return;
+	limbs.assign(m.backend().limbs(), m.backend().limbs()+n);
+	// m^-1 mod 2^64 by Newton's iteration, as in Modulus64
+	uint64_t inverse = limbs[0];
+	for(int i=0; i<5; i++) inverse *= 2-limbs[0]*inverse;
+	mInverse = -inverse;
+	one.resize(n);
+	r2.resize(n);
+	load((cpp_int(1) << (64*n)) % m, one.data());
+	load((cpp_int(1) << (128*n)) % m, r2.data());
+    }
+
+    // t = T*R^-1 mod m, for the 2n-limb T < m*R held in t; the result is
+    // left in t[n..2n)
+    void BigModulus::montgomeryReduce(uint64_t * t, uint64_t * out) const
+    {
+	const uint64_t * p = limbs.data();
+	uint64_t extra = 0;
+	for(int i=0; i<n; i++)
+	{
+	    // add q*m*2^(64i), with q chosen so that limb i vanishes
+	    uint64_t q = t[i]*mInverse;
+	    unsigned __int128 carry = 0;
+	    for(int j=0; j<n; j++)
+	    {
+		carry += (unsigned __int128)q*p[j] + t[i+j];
+		t[i+j] = (uint64_t)carry;
+		carry >>= 64;
+	    }
+	    carry += (unsigned __int128)t[i+n] + extra;
+	    t[i+n] = (uint64_t)carry;
+	    extra = (uint64_t)(carry >> 64);
+	}
+
+	// the result is below 2m: subtract m once if needed
+	uint64_t * r = t+n;
+	bool subtract = extra!=0;
+	if(!subtract)
+	{
+	    subtract = true;
+	    for(int j=n-1; j>=0; j--)
+	    {
+		if(r[j]!=p[j])
+		{
+		    subtract = r[j]>p[j];
+		    break;
+		}
+	    }
+	}
+	if(subtract)
+	{
+	    uint64_t borrow = 0;
+	    for(int j=0; j<n; j++)
+	    {
+		unsigned __int128 d = (unsigned __int128)r[j] - p[j] - borrow;
+		out[j] = (uint64_t)d;
+		borrow = (uint64_t)(d >> 64) & 1;
+	    }
+	}
+	else std::copy(r, r+n, out);
+    }
+
+    void BigModulus::montgomeryMul(const uint64_t * a, const uint64_t * b, uint64_t * out, uint64_t * t) const
+    {
+	for(int i=0; i<n; i++)
+	{
+	    unsigned __int128 carry = 0;
+	    uint64_t ai = a[i];
+	    for(int j=0; j<n; j++)
+	    {
+		carry += (unsigned __int128)ai*b[j] + (i ? t[i+j] : 0);
+		t[i+j] = (uint64_t)carry;
+		carry >>= 64;
+	    }
+	    t[i+n] = (uint64_t)carry;
+	}
+	montgomeryReduce(t, out);
+    }
+
+    // the products a[i]*a[j] with i < j are computed once and doubled, so a
+    // square costs about 3/4 of a multiplication
+    void BigModulus::montgomerySquare(const uint64_t * a, uint64_t * out, uint64_t * t) const
+    {
+	std::fill(t, t+2*n, 0);
+	for(int i=0; i<n; i++)
+	{
+	    unsigned __int128 carry = 0;
+	    uint64_t ai = a[i];
+	    for(int j=i+1; j<n; j++)
+	    {
+		carry += (unsigned __int128)ai*a[j] + t[i+j];
+		t[i+j] = (uint64_t)carry;
+		carry >>= 64;
+	    }
+	    t[i+n] = (uint64_t)carry;
+	}
+	uint64_t high = 0;
+	unsigned __int128 carry = 0;
+	for(int i=0; i<n; i++)
+	{
+	    // double t[2i], t[2i+1] and add a[i]^2
+	    unsigned __int128 square = (unsigned __int128)a[i]*a[i];
+	    uint64_t lo = t[2*i], hi = t[2*i+1];
+	    carry += (unsigned __int128)((lo << 1) | high) + (uint64_t)square;
+	    t[2*i] = (uint64_t)carry;
+	    carry >>= 64;
+	    carry += (unsigned __int128)((hi << 1) | (lo >> 63)) + (uint64_t)(square >> 64);
+	    t[2*i+1] = (uint64_t)carry;
+	    carry >>= 64;
+	    high = hi >> 63;
+	}
+	montgomeryReduce(t, out);
+    }
+
+    void BigModulus::load(const cpp_int & a, uint64_t * out) const
+    {
+	if(a<0 || a>=m)
+	{
+	    cpp_int r = a % m;
+	    if(r<0) r += m;
+	    return load(r, out);
+	}
+	size_t size = a==0 ? 0 : a.backend().size();
+	std::copy(a.backend().limbs(), a.backend().limbs()+size, out);
+	std::fill(out+size, out+n, 0);
+    }
+
+    void BigModulus::store(const uint64_t * a, cpp_int & out) const
+    {
+	out.backend().resize(n, n);
+	std::copy(a, a+n, out.backend().limbs());
+	out.backend().sign(false);
+	out.backend().normalize();
+    }
+
+    void BigModulus::mul(const cpp_int & a, const cpp_int & b, cpp_int & out, std::vector<uint64_t> & scratch) const
+    {
+	if(limbs.empty())
+	{
+	    out = a*b % m;
+	    if(out<0) out += m;
+	    return;
+	}
+	scratch.resize(4*n);
+	uint64_t * x = scratch.data(), * y = x+n, * t = y+n;
+	load(a, x);
+	load(b, y);
+	// (a*b*R^-1) * (R^2) * R^-1 = a*b
+	montgomeryMul(x, y, x, t);
+	montgomeryMul(x, r2.data(), x, t);
+	store(x, out);
+    }
+
+    void BigModulus::pow(const cpp_int & base, const cpp_int & exponent, cpp_int & out, std::vector<uint64_t> & scratch) const
+    {
+	if(limbs.empty())
+	{
+	    out = powmod(base, exponent, m);
+	    return;
+	}
+	if(exponent<0)
+	{
+	    cpp_int inverse = modularInverse(base, m);
+	    if(inverse==0) out = -1;
+	    else pow(inverse, -exponent, out, scratch);
+	    return;
+	}
+	int bits = exponent==0 ? 0 : (int)msb(exponent)+1;
+	int w = bits>671 ? 6 : bits>239 ? 5 : bits>79 ? 4 : bits>23 ? 3 : bits>6 ? 2 : 1;
+	int count = 1 << (w-1);
+
+	// table[i] = base^(2i+1), then the accumulator, a square, and the
+	// Montgomery temporary
+	scratch.resize((count+2)*n+2*n);
+	uint64_t * table = scratch.data(), * acc = table+count*n, * square = acc+n, * t = square+n;
+	load(base, table);
+	montgomeryMul(table, r2.data(), table, t);
+	if(count>1) montgomerySquare(table, square, t);
+	for(int i=1; i<count; i++) montgomeryMul(table+(i-1)*n, square, table+i*n, t);
+
+	const limb_type * e = exponent.backend().limbs();
+	auto bit = [e](int i) { return (e[i/64] >> (i%64)) & 1; };
+	std::copy(one.begin(), one.end(), acc);
+	bool started = false;
+	for(int i=bits-1; i>=0; )
+	{
+	    if(!bit(i))
+	    {
+		if(started) montgomerySquare(acc, acc, t);
+		i--;
+		continue;
+	    }
+	    // the longest window of at most w bits that starts at bit i and
+	    // ends with a 1
+	    int j = std::max(i-w+1, 0);
+	    while(!bit(j)) j++;
+	    int window = 0;
+	    for(int k=i; k>=j; k--) window = 2*window + (int)bit(k);
+	    if(started)
+	    {
+		for(int k=i; k>=j; k--) montgomerySquare(acc, acc, t);
+		montgomeryMul(acc, table+(window>>1)*n, acc, t);
+	    }
+	    else std::copy(table+(window>>1)*n, table+(window>>1)*n+n, acc);
+	    started = true;
+	    i = j-1;
+	}
+
+	// out of Montgomery form: multiply by 1
+	std::fill(square, square+n, 0);
+	square[0] = 1;
+	montgomeryMul(acc, square, acc, t);
+	store(acc, out);
+    }
+
+    cpp_int BigModulus::pow(const cpp_int & base, const cpp_int & exponent) const
+    {
+	std::vector<uint64_t> scratch;
+	cpp_int ans;
+	pow(base, exponent, ans, scratch);
+	return ans;
+    }
+
 }
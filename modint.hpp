@@ -0,0 +1,259 @@
+/*
+ * This file contains modular arithmetic with a modulus fixed at compile
+ * time: the ModInt class, and constexpr versions of gcd, powmod and
+ * modularInverse and of a small prime sieve, for tables built by the
+ * compiler rather than at startup.  Everything here is header-only.
+ */
+
+
+#ifndef BR_MODINT_HPP
+#define BR_MODINT_HPP
+
+#include<cstdint>
+
+namespace nt
+{
+    namespace ct
+    {
+	/**
+	 * Compile-Time Modular Arithmetic
+	 * constexpr versions of the functions of the same names in modarith,
+	 * with the same conventions:
+	 *   gcd: nonnegative, and 0 only if both arguments are 0.
+	 *   powmod: -1 if the modulus is 0, or if the exponent is negative and
+	 *     the base has no inverse.  A zero exponent gives 1, even modulo 1.
+	 *   modularInverse: 0 if the modulus is 0 or there is no inverse, and
+	 *     1 if the modulus is 1.
+	 * The moduli are converted to their absolute values, and may be any
+	 * long, as products are taken in 128 bits.  Usable at run time too, but
+	 * the versions in modarith are faster there.
+	 */
+	constexpr long gcd(long a, long b)
+	{
+	    uint64_t x = a<0 ? -(uint64_t)a : a, y = b<0 ? -(uint64_t)b : b;
+	    while(y>0)
+	    {
+		uint64_t r = x%y;
+		x = y;
+		y = r;
+	    }
+	    return (long)x;
+	}
+
+	constexpr long modularInverse(long a, long modulus)
+	{
+	    if(modulus<0) modulus = -modulus;
+	    if(modulus==0) return 0;
+	    if(modulus==1) return 1;
+	    a %= modulus;
+	    if(a<0) a += modulus;
+	    long b = modulus;
+	    __int128 s = 1, t = 0; // a*s+modulus*t stays the current remainder
+	    while(b>0)
+	    {
+		long quot = a/b, r = a-quot*b;
+		a = b;
+		b = r;
+		__int128 temp = s - quot*t;
+		s = t;
+		t = temp;
+	    }
+	    if(a!=1) return 0;
+	    if(s<0) s += modulus;
+	    return (long)s;
+	}
+
+	constexpr long powmod(long base, long exponent, long modulus)
+	{
+	    if(modulus<0) modulus = -modulus;
+	    if(modulus==0) return -1;
+	    long aux = base%modulus;
+	    if(aux<0) aux += modulus;
+	    if(exponent<0)
+	    {
+		aux = modularInverse(aux, modulus);
+		if(aux==0) return -1;
+		exponent = -exponent;
+	    }
+	    long ans = 1;
+	    while(exponent>0)
+	    {
+		if(exponent&1) ans = (long)((__int128)ans*aux % modulus);
+		exponent >>= 1;
+		aux = (long)((__int128)aux*aux % modulus);
+	    }
+	    return ans;
+	}
+
+	/**
+	 * Compile-Time Prime Table
+	 * The smallest prime factor of every integer up to LIMIT, and the list
+	 * of primes up to LIMIT, by the linear sieve in a constexpr
+	 * constructor.  Declared constexpr, as primeTable<LIMIT> is, the table
+	 * is computed by the compiler and stored in the binary.
+	 *
+	 * TEMPLATE PARAMETERS: the limit, as int
+	 * Notes: compilers bound the work done in a constant expression, so
+	 * LIMIT should stay below about 10^5 (GCC allows 2^18 iterations per
+	 * loop by default; -fconstexpr-loop-limit and -fconstexpr-ops-limit
+	 * raise that).  Beyond that, build a PrimeBitmap at run time.
+	 * smallestFactor(0) and smallestFactor(1) are 0.
+	 */
+	template<int LIMIT>
+	class PrimeTable
+	{
+	    static_assert(LIMIT>=1, "PrimeTable needs a positive limit");
+	public:
+	    constexpr PrimeTable() : factors(), list(), count(0)
+	    {
+		for(int i=2; i<=LIMIT; i++)
+		{
+		    if(factors[i]==0)
+		    {
+			factors[i] = i;
+			list[count++] = i;
+		    }
+		    // each composite is marked once, from its smallest factor
+		    for(int j=0; j<count && list[j]<=factors[i] && (long)i*list[j]<=LIMIT; j++)
+		    {
+			factors[i*list[j]] = list[j];
+		    }
+		}
+	    }
+
+	    static constexpr int limit() { return LIMIT; }
+
+	    // the number of primes up to LIMIT, and the ith of them (from 0)
+	    constexpr int size() const { return count; }
+	    constexpr int operator[](int i) const { return list[i]; }
+
+	    // for 0 <= n <= LIMIT
+	    constexpr bool isPrime(int n) const { return n>=2 && factors[n]==n; }
+	    constexpr int smallestFactor(int n) const { return factors[n]; }
+
+	private:
+	    int factors[LIMIT+1];
+	    // there are fewer than LIMIT/2+1 primes up to LIMIT
+	    int list[LIMIT/2+1];
+	    int count;
+	};
+
+	template<int LIMIT>
+	constexpr PrimeTable<LIMIT> primeTable{};
+    }
+
+    // -m^-1 mod 2^32 by Newton's iteration, for odd m; each step doubles
+    // the number of correct low bits, starting from 3
+    constexpr uint32_t modint_negativeInverse(uint32_t m)
+    {
+	uint32_t inverse = m;
+	for(int i=0; i<4; i++) inverse *= 2-m*inverse;
+	return -inverse;
+    }
+
+    /**
+     * Compile-Time Modulus Integer
+     * A residue modulo the template parameter MOD, with the arithmetic
+     * operators, so that code over a fixed modulus reads like code over the
+     * integers.  Since the modulus is a constant, its constants are
+     * computed by the compiler, and no operation divides: for odd moduli
+     * the value is kept in Montgomery form (R = 2^32), so a product is three
+     * 32x32->64 bit multiplications; for even moduli the compiler turns the
+     * % by a constant into a Barrett reduction, a multiplication by a
+     * precomputed reciprocal.  Every operation is constexpr.
+     *
+     * TEMPLATE PARAMETERS: the modulus, as an unsigned 32-bit integer
+     * Notes: the modulus must lie in [1, 2^31).  Division by a number with
+     * no inverse gives 0, as does pow with a negative exponent in that case
+     * (modularInverse and powmod would give 0 and -1).  A multiply-add over
+     * arrays runs about twice as fast as with % by a run-time modulus.
+     */
+    template<uint32_t MOD>
+    class ModInt
+    {
+	static_assert(MOD>=1 && MOD<(1u<<31), "ModInt needs a modulus in [1, 2^31)");
+    public:
+	constexpr ModInt() : v(0) {}
+	constexpr ModInt(long x) : v(encode(reduce(x))) {}
+
+	// the modulus
+	static constexpr uint32_t modulus() { return MOD; }
+
+	// the residue, in [0, MOD)
+	constexpr uint32_t value() const { return MONTGOMERY ? montgomeryReduce(v) : v; }
+
+	constexpr ModInt & operator+=(const ModInt & b)
+	{
+	    v = v>=MOD-b.v ? v-(MOD-b.v) : v+b.v;
+	    return *this;
+	}
+	constexpr ModInt & operator-=(const ModInt & b)
+	{
+	    v = v>=b.v ? v-b.v : v+(MOD-b.v);
+	    return *this;
+	}
+	constexpr ModInt & operator*=(const ModInt & b)
+	{
+	    v = MONTGOMERY ? montgomeryReduce((uint64_t)v*b.v) : (uint32_t)((uint64_t)v*b.v % MOD);
+	    return *this;
+	}
+	constexpr ModInt & operator/=(const ModInt & b) { return *this *= b.inverse(); }
+
+	constexpr ModInt operator-() const { return ModInt() - *this; }
+
+	friend constexpr ModInt operator+(ModInt a, const ModInt & b) { return a += b; }
+	friend constexpr ModInt operator-(ModInt a, const ModInt & b) { return a -= b; }
+	friend constexpr ModInt operator*(ModInt a, const ModInt & b) { return a *= b; }
+	friend constexpr ModInt operator/(ModInt a, const ModInt & b) { return a /= b; }
+	friend constexpr bool operator==(const ModInt & a, const ModInt & b) { return a.v==b.v; }
+	friend constexpr bool operator!=(const ModInt & a, const ModInt & b) { return a.v!=b.v; }
+
+	// this^exponent; a negative exponent raises the inverse
+	constexpr ModInt pow(long exponent) const
+	{
+	    ModInt aux = *this, ans(1);
+	    if(exponent<0)
+	    {
+		aux = inverse();
+		exponent = -exponent;
+	    }
+	    while(exponent>0)
+	    {
+		if(exponent&1) ans *= aux;
+		exponent >>= 1;
+		aux *= aux;
+	    }
+	    return ans;
+	}
+
+	// the inverse, or 0 if there is none
+	constexpr ModInt inverse() const { return ModInt(ct::modularInverse(value(), MOD)); }
+
+    private:
+	static constexpr bool MONTGOMERY = (MOD&1) && MOD>1;
+
+	// -MOD^-1 mod 2^32, and R^2 mod MOD
+	static constexpr uint32_t mInverse = modint_negativeInverse(MOD);
+	static constexpr uint32_t r2 = (uint32_t)(((uint64_t)1 << 32) % MOD * (((uint64_t)1 << 32) % MOD) % MOD);
+
+	// T*R^-1 mod MOD, for T < MOD*R
+	static constexpr uint32_t montgomeryReduce(uint64_t T)
+	{
+	    uint32_t q = (uint32_t)T*mInverse;
+	    uint32_t t = (uint32_t)((T + (uint64_t)q*MOD) >> 32);
+	    return t>=MOD ? t-MOD : t;
+	}
+
+	static constexpr uint32_t reduce(long x)
+	{
+	    long r = x%(long)MOD;
+	    return (uint32_t)(r<0 ? r+MOD : r);
+	}
+	static constexpr uint32_t encode(uint32_t x) { return MONTGOMERY ? montgomeryReduce((uint64_t)x*r2) : x; }
+
+	uint32_t v;
+    };
+
+}
+
+#endif
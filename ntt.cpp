@@ -0,0 +1,696 @@
+// implementation of the number theoretic transform and polynomial products
+
+#include "numthy/ntt.hpp"
+#include "numthy/modarith.hpp"
+#include<algorithm>
+#include<map>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include<immintrin.h>
+#define BR_NTT_SIMD
+#endif
+
+using std::vector;
+
+namespace nt
+{
+    // three primes of the form c*2^k+1, whose product (about 2^86) bounds
+    // the exact convolutions
+    static const int NTT_PRIMES[3] = {998244353, 167772161, 469762049};
+    static const int NTT_MAX_SIZE = 1 << 23;
+
+    // below this many terms in the shorter input, the schoolbook product wins
+    static const int CONVOLVE_SCHOOLBOOK = 32;
+
+    // the smallest primitive root mod prime
+    int ntt_primitiveRoot(int prime)
+    {
+	if(prime==2) return 1;
+	vector<int> factors;
+	int rest = prime-1;
+	for(int q=2; (long)q*q<=rest; q++)
+	{
+	    if(rest%q) continue;
+	    factors.push_back(q);
+	    while(rest%q==0) rest /= q;
+	}
+	if(rest>1) factors.push_back(rest);
+
+	Modulus mod(prime);
+	for(int g=2; ; g++)
+	{
+	    bool primitive = true;
+	    for(size_t i=0; i<factors.size() && primitive; i++)
+	    {
+		primitive = mod.pow(g, (prime-1)/factors[i])!=1;
+	    }
+	    if(primitive) return g;
+	}
+    }
+
+    // residues stay in [0, p): a sum or difference is brought back by an
+    // unsigned min, as one of the two candidates has wrapped around
+    inline uint32_t ntt_add(uint32_t a, uint32_t b, uint32_t p) { return std::min(a+b, a+b-p); }
+    inline uint32_t ntt_sub(uint32_t a, uint32_t b, uint32_t p) { return std::min(a-b, a-b+p); }
+
+    // Montgomery product a*b*2^-32 mod p, for a*b < p*2^32
+    inline uint32_t ntt_mul(uint32_t a, uint32_t b, uint32_t p, uint32_t mInverse)
+    {
+	uint64_t T = (uint64_t)a*b;
+	uint32_t q = (uint32_t)T*mInverse;
+	uint32_t hi = (uint32_t)(T>>32), qm = (uint32_t)(((uint64_t)q*p)>>32);
+	return hi>=qm ? hi-qm : hi-qm+p;
+    }
+
+    // one radix-4 level over blocks of 4h: the two radix-2 levels of half
+    // size 2h and h.  The twiddles are w1 = w^j, w2 = w^2j and w3 = w^3j for
+    // a primitive (4h)th root w, and I = w^h.
+    void ntt_forward4(uint32_t * a, long n, long h, const uint32_t * roots, uint32_t I, uint32_t p, uint32_t mInverse)
+    {
+	for(long start=0; start<n; start += 4*h)
+	{
+	    uint32_t * x = a+start;
+	    for(long j=0; j<h; j++)
+	    {
+		uint32_t w1 = roots[2*h+j], w2 = roots[h+j], w3 = ntt_mul(w1, w2, p, mInverse);
+		uint32_t x0 = x[j], x1 = x[j+h], x2 = x[j+2*h], x3 = x[j+3*h];
+		uint32_t s02 = ntt_add(x0, x2, p), d02 = ntt_sub(x0, x2, p);
+		uint32_t s13 = ntt_add(x1, x3, p), d13 = ntt_mul(ntt_sub(x1, x3, p), I, p, mInverse);
+		x[j] = ntt_add(s02, s13, p);
+		x[j+h] = ntt_mul(ntt_sub(s02, s13, p), w2, p, mInverse);
+		x[j+2*h] = ntt_mul(ntt_add(d02, d13, p), w1, p, mInverse);
+		x[j+3*h] = ntt_mul(ntt_sub(d02, d13, p), w3, p, mInverse);
+	    }
+	}
+    }
+
+    // the inverse of ntt_forward4, with the inverse roots
+    void ntt_backward4(uint32_t * a, long n, long h, const uint32_t * roots, uint32_t J, uint32_t p, uint32_t mInverse)
+    {
+	for(long start=0; start<n; start += 4*h)
+	{
+	    uint32_t * x = a+start;
+	    for(long j=0; j<h; j++)
+	    {
+		uint32_t w1 = roots[2*h+j], w2 = roots[h+j], w3 = ntt_mul(w1, w2, p, mInverse);
+		uint32_t x0 = x[j], y1 = ntt_mul(x[j+h], w2, p, mInverse);
+		uint32_t y2 = ntt_mul(x[j+2*h], w1, p, mInverse), y3 = ntt_mul(x[j+3*h], w3, p, mInverse);
+		uint32_t s01 = ntt_add(x0, y1, p), d01 = ntt_sub(x0, y1, p);
+		uint32_t s23 = ntt_add(y2, y3, p), d23 = ntt_mul(ntt_sub(y2, y3, p), J, p, mInverse);
+		x[j] = ntt_add(s01, s23, p);
+		x[j+h] = ntt_add(d01, d23, p);
+		x[j+2*h] = ntt_sub(s01, s23, p);
+		x[j+3*h] = ntt_sub(d01, d23, p);
+	    }
+	}
+    }
+
+#ifdef BR_NTT_SIMD
+    // the same butterflies, 8 lanes at a time
+    __attribute__((target("avx2")))
+    inline __m256i ntt_mulAVX2(__m256i a, __m256i b, __m256i p, __m256i mInverse)
+    {
+	__m256i tEven = _mm256_mul_epu32(a, b);
+	__m256i tOdd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+	__m256i qpEven = _mm256_mul_epu32(_mm256_mul_epu32(tEven, mInverse), p);
+	__m256i qpOdd = _mm256_mul_epu32(_mm256_mul_epu32(tOdd, mInverse), p);
+	__m256i tHigh = _mm256_blend_epi32(_mm256_srli_epi64(tEven, 32), tOdd, 0xAA);
+	__m256i qpHigh = _mm256_blend_epi32(_mm256_srli_epi64(qpEven, 32), qpOdd, 0xAA);
+	__m256i d = _mm256_sub_epi32(tHigh, qpHigh);
+	return _mm256_min_epu32(d, _mm256_add_epi32(d, p));
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i ntt_addAVX2(__m256i a, __m256i b, __m256i p)
+    {
+	__m256i s = _mm256_add_epi32(a, b);
+	return _mm256_min_epu32(s, _mm256_sub_epi32(s, p));
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i ntt_subAVX2(__m256i a, __m256i b, __m256i p)
+    {
+	__m256i d = _mm256_sub_epi32(a, b);
+	return _mm256_min_epu32(d, _mm256_add_epi32(d, p));
+    }
+
+    __attribute__((target("avx2")))
+    void ntt_forward4AVX2(uint32_t * a, long n, long h, const uint32_t * roots, uint32_t I, uint32_t p, uint32_t mInverse)
+    {
+	__m256i vp = _mm256_set1_epi32(p), vm = _mm256_set1_epi32(mInverse), vI = _mm256_set1_epi32(I);
+	for(long start=0; start<n; start += 4*h)
+	{
+	    __m256i * x0 = (__m256i *)(a+start), * x1 = (__m256i *)(a+start+h);
+	    __m256i * x2 = (__m256i *)(a+start+2*h), * x3 = (__m256i *)(a+start+3*h);
+	    for(long j=0; j<h/8; j++)
+	    {
+		__m256i w1 = _mm256_loadu_si256((const __m256i *)(roots+2*h)+j), w2 = _mm256_loadu_si256((const __m256i *)(roots+h)+j);
+		__m256i w3 = ntt_mulAVX2(w1, w2, vp, vm);
+		__m256i y0 = _mm256_loadu_si256(x0+j), y1 = _mm256_loadu_si256(x1+j);
+		__m256i y2 = _mm256_loadu_si256(x2+j), y3 = _mm256_loadu_si256(x3+j);
+		__m256i s02 = ntt_addAVX2(y0, y2, vp), d02 = ntt_subAVX2(y0, y2, vp);
+		__m256i s13 = ntt_addAVX2(y1, y3, vp), d13 = ntt_mulAVX2(ntt_subAVX2(y1, y3, vp), vI, vp, vm);
+		_mm256_storeu_si256(x0+j, ntt_addAVX2(s02, s13, vp));
+		_mm256_storeu_si256(x1+j, ntt_mulAVX2(ntt_subAVX2(s02, s13, vp), w2, vp, vm));
+		_mm256_storeu_si256(x2+j, ntt_mulAVX2(ntt_addAVX2(d02, d13, vp), w1, vp, vm));
+		_mm256_storeu_si256(x3+j, ntt_mulAVX2(ntt_subAVX2(d02, d13, vp), w3, vp, vm));
+	    }
+	}
+    }
+
+    __attribute__((target("avx2")))
+    void ntt_backward4AVX2(uint32_t * a, long n, long h, const uint32_t * roots, uint32_t J, uint32_t p, uint32_t mInverse)
+    {
+	__m256i vp = _mm256_set1_epi32(p), vm = _mm256_set1_epi32(mInverse), vJ = _mm256_set1_epi32(J);
+	for(long start=0; start<n; start += 4*h)
+	{
+	    __m256i * x0 = (__m256i *)(a+start), * x1 = (__m256i *)(a+start+h);
+	    __m256i * x2 = (__m256i *)(a+start+2*h), * x3 = (__m256i *)(a+start+3*h);
+	    for(long j=0; j<h/8; j++)
+	    {
+		__m256i w1 = _mm256_loadu_si256((const __m256i *)(roots+2*h)+j), w2 = _mm256_loadu_si256((const __m256i *)(roots+h)+j);
+		__m256i w3 = ntt_mulAVX2(w1, w2, vp, vm);
+		__m256i y0 = _mm256_loadu_si256(x0+j), y1 = ntt_mulAVX2(_mm256_loadu_si256(x1+j), w2, vp, vm);
+		__m256i y2 = ntt_mulAVX2(_mm256_loadu_si256(x2+j), w1, vp, vm), y3 = ntt_mulAVX2(_mm256_loadu_si256(x3+j), w3, vp, vm);
+		__m256i s01 = ntt_addAVX2(y0, y1, vp), d01 = ntt_subAVX2(y0, y1, vp);
+		__m256i s23 = ntt_addAVX2(y2, y3, vp), d23 = ntt_mulAVX2(ntt_subAVX2(y2, y3, vp), vJ, vp, vm);
+		_mm256_storeu_si256(x0+j, ntt_addAVX2(s01, s23, vp));
+		_mm256_storeu_si256(x1+j, ntt_addAVX2(d01, d23, vp));
+		_mm256_storeu_si256(x2+j, ntt_subAVX2(s01, s23, vp));
+		_mm256_storeu_si256(x3+j, ntt_subAVX2(d01, d23, vp));
+	    }
+	}
+    }
+
+    // GCC 12 reports its own avx512fintrin.h as using uninitialized values
+    // in _mm512_mul_epu32 and _mm512_srli_epi64; the warning is spurious
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    // and 16 lanes at a time
+    __attribute__((target("avx512f")))
+    inline __m512i ntt_mulAVX512(__m512i a, __m512i b, __m512i p, __m512i mInverse)
+    {
+	__m512i tEven = _mm512_mul_epu32(a, b);
+	__m512i tOdd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+	__m512i qpEven = _mm512_mul_epu32(_mm512_mul_epu32(tEven, mInverse), p);
+	__m512i qpOdd = _mm512_mul_epu32(_mm512_mul_epu32(tOdd, mInverse), p);
+	__m512i tHigh = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(tEven, 32), tOdd);
+	__m512i qpHigh = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(qpEven, 32), qpOdd);
+	__m512i d = _mm512_sub_epi32(tHigh, qpHigh);
+	return _mm512_min_epu32(d, _mm512_add_epi32(d, p));
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512i ntt_addAVX512(__m512i a, __m512i b, __m512i p)
+    {
+	__m512i s = _mm512_add_epi32(a, b);
+	return _mm512_min_epu32(s, _mm512_sub_epi32(s, p));
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512i ntt_subAVX512(__m512i a, __m512i b, __m512i p)
+    {
+	__m512i d = _mm512_sub_epi32(a, b);
+	return _mm512_min_epu32(d, _mm512_add_epi32(d, p));
+    }
+
+    __attribute__((target("avx512f")))
+    void ntt_forward4AVX512(uint32_t * a, long n, long h, const uint32_t * roots, uint32_t I, uint32_t p, uint32_t mInverse)
+    {
+	__m512i vp = _mm512_set1_epi32(p), vm = _mm512_set1_epi32(mInverse), vI = _mm512_set1_epi32(I);
+	for(long start=0; start<n; start += 4*h)
+	{
+	    uint32_t * x0 = a+start, * x1 = a+start+h, * x2 = a+start+2*h, * x3 = a+start+3*h;
+	    for(long j=0; j<h; j += 16)
+	    {
+		__m512i w1 = _mm512_loadu_si512(roots+2*h+j), w2 = _mm512_loadu_si512(roots+h+j);
+		__m512i w3 = ntt_mulAVX512(w1, w2, vp, vm);
+		__m512i y0 = _mm512_loadu_si512(x0+j), y1 = _mm512_loadu_si512(x1+j);
+		__m512i y2 = _mm512_loadu_si512(x2+j), y3 = _mm512_loadu_si512(x3+j);
+		__m512i s02 = ntt_addAVX512(y0, y2, vp), d02 = ntt_subAVX512(y0, y2, vp);
+		__m512i s13 = ntt_addAVX512(y1, y3, vp), d13 = ntt_mulAVX512(ntt_subAVX512(y1, y3, vp), vI, vp, vm);
+		_mm512_storeu_si512(x0+j, ntt_addAVX512(s02, s13, vp));
+		_mm512_storeu_si512(x1+j, ntt_mulAVX512(ntt_subAVX512(s02, s13, vp), w2, vp, vm));
+		_mm512_storeu_si512(x2+j, ntt_mulAVX512(ntt_addAVX512(d02, d13, vp), w1, vp, vm));
+		_mm512_storeu_si512(x3+j, ntt_mulAVX512(ntt_subAVX512(d02, d13, vp), w3, vp, vm));
+	    }
+	}
+    }
+
+    __attribute__((target("avx512f")))
+    void ntt_backward4AVX512(uint32_t * a, long n, long h, const uint32_t * roots, uint32_t J, uint32_t p, uint32_t mInverse)
+    {
+	__m512i vp = _mm512_set1_epi32(p), vm = _mm512_set1_epi32(mInverse), vJ = _mm512_set1_epi32(J);
+	for(long start=0; start<n; start += 4*h)
+	{
+	    uint32_t * x0 = a+start, * x1 = a+start+h, * x2 = a+start+2*h, * x3 = a+start+3*h;
+	    for(long j=0; j<h; j += 16)
+	    {
+		__m512i w1 = _mm512_loadu_si512(roots+2*h+j), w2 = _mm512_loadu_si512(roots+h+j);
+		__m512i w3 = ntt_mulAVX512(w1, w2, vp, vm);
+		__m512i y0 = _mm512_loadu_si512(x0+j), y1 = ntt_mulAVX512(_mm512_loadu_si512(x1+j), w2, vp, vm);
+		__m512i y2 = ntt_mulAVX512(_mm512_loadu_si512(x2+j), w1, vp, vm), y3 = ntt_mulAVX512(_mm512_loadu_si512(x3+j), w3, vp, vm);
+		__m512i s01 = ntt_addAVX512(y0, y1, vp), d01 = ntt_subAVX512(y0, y1, vp);
+		__m512i s23 = ntt_addAVX512(y2, y3, vp), d23 = ntt_mulAVX512(ntt_subAVX512(y2, y3, vp), vJ, vp, vm);
+		_mm512_storeu_si512(x0+j, ntt_addAVX512(s01, s23, vp));
+		_mm512_storeu_si512(x1+j, ntt_addAVX512(d01, d23, vp));
+		_mm512_storeu_si512(x2+j, ntt_subAVX512(s01, s23, vp));
+		_mm512_storeu_si512(x3+j, ntt_subAVX512(d01, d23, vp));
+	    }
+	}
+    }
+#pragma GCC diagnostic pop
+#endif
+
+    // 2 for AVX-512, 1 for AVX2, 0 for neither
+    int ntt_simdLevel()
+    {
+#ifdef BR_NTT_SIMD
+	static const int level = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+	return level;
+#else
+	return 0;
+#endif
+    }
+
+    //NTT Context
+    NTT::NTT(int prime) : p(prime), largest(1), root(ntt_primitiveRoot(prime)), roots(1), inverseRoots(1)
+    {
+	mInverse = p;
+	for(int i=0; i<4; i++) mInverse *= 2-p*mInverse;
+	one = (uint32_t)(((uint64_t)1 << 32) % p);
+	r2 = (uint32_t)((uint64_t)one*one % p);
+	while((p-1)%(2*largest)==0 && largest < (1L << 30)) largest *= 2;
+	Modulus mod(p);
+	imaginary = largest%4==0 ? toMontgomery(mod.pow(root, (p-1)/4)) : 0;
+	inverseImaginary = largest%4==0 ? toMontgomery(mod.pow(root, -(long)((p-1)/4))) : 0;
+    }
+
+    uint32_t NTT::mul(uint32_t a, uint32_t b) const
+    {
+	return ntt_mul(a, b, p, mInverse);
+    }
+
+    void NTT::grow(long size)
+    {
+	long old = roots.size();
+	if(size<=old) return;
+	Modulus mod(p);
+	roots.resize(size);
+	inverseRoots.resize(size);
+	for(long L=old; L<size; L *= 2)
+	{
+	    uint32_t w = toMontgomery(mod.pow(root, (p-1)/(2*L)));
+	    uint32_t v = toMontgomery(mod.pow(root, -(long)((p-1)/(2*L))));
+	    roots[L] = inverseRoots[L] = one;
+	    for(long j=1; j<L; j++)
+	    {
+		roots[L+j] = mul(roots[L+j-1], w);
+		inverseRoots[L+j] = mul(inverseRoots[L+j-1], v);
+	    }
+	}
+    }
+
+    void NTT::forward(uint32_t * a, long n) const
+    {
+	int level = ntt_simdLevel();
+	long L = n/2;
+	if(__builtin_ctzl(n)%2)
+	{
+	    for(long j=0; j<L; j++)
+	    {
+		uint32_t u = a[j], v = a[j+L];
+		a[j] = ntt_add(u, v, p);
+		a[j+L] = mul(ntt_sub(u, v, p), roots[L+j]);
+	    }
+	    L /= 2;
+	}
+	for(; L>=2; L /= 4)
+	{
+	    long h = L/2;
+#ifdef BR_NTT_SIMD
+	    if(level==2 && h%16==0)
+	    {
+		ntt_forward4AVX512(a, n, h, roots.data(), imaginary, p, mInverse);
+		continue;
+	    }
+	    if(level>=1 && h%8==0)
+	    {
+		ntt_forward4AVX2(a, n, h, roots.data(), imaginary, p, mInverse);
+		continue;
+	    }
+#endif
+	    ntt_forward4(a, n, h, roots.data(), imaginary, p, mInverse);
+	}
+	(void)level;
+    }
+
+    void NTT::backward(uint32_t * a, long n, uint32_t scale) const
+    {
+	int level = ntt_simdLevel();
+	long h = 1;
+	for(; 4*h<=n; h *= 4)
+	{
+#ifdef BR_NTT_SIMD
+	    if(level==2 && h%16==0)
+	    {
+		ntt_backward4AVX512(a, n, h, inverseRoots.data(), inverseImaginary, p, mInverse);
+		continue;
+	    }
+	    if(level>=1 && h%8==0)
+	    {
+		ntt_backward4AVX2(a, n, h, inverseRoots.data(), inverseImaginary, p, mInverse);
+		continue;
+	    }
+#endif
+	    ntt_backward4(a, n, h, inverseRoots.data(), inverseImaginary, p, mInverse);
+	}
+	if(h<n)
+	{
+	    for(long j=0; j<h; j++)
+	    {
+		uint32_t u = a[j], v = mul(a[j+h], inverseRoots[h+j]);
+		a[j] = ntt_add(u, v, p);
+		a[j+h] = ntt_sub(u, v, p);
+	    }
+	}
+	for(long i=0; i<n; i++) a[i] = mul(a[i], scale);
+	(void)level;
+    }
+
+    bool NTT::transform(vector<int> & a, bool inverse)
+    {
+	long n = a.size();
+	if(n==0 || (n&(n-1)) || n>largest) return false;
+	if(n==1) return true;
+	grow(n);
+	uint32_t * x = (uint32_t *)a.data();
+	if(!inverse) forward(x, n);
+	// n^-1 in Montgomery form, so that the last multiplication divides by n
+	else backward(x, n, toMontgomery(Modulus(p).inverse(n)));
+	return true;
+    }
+
+    bool NTT::multiply(const vector<int> & a, const vector<int> & b, vector<int> & out)
+    {
+	if(a.empty() || b.empty())
+	{
+	    out.clear();
+	    return true;
+	}
+	long size = a.size()+b.size()-1, n = 1;
+	while(n<size) n *= 2;
+	if(n>largest) return false;
+	grow(n);
+	vector<int> fb(n, 0);
+	vector<int> fa(n, 0);
+	for(size_t i=0; i<a.size(); i++) fa[i] = a[i] % (int)p;
+	for(size_t i=0; i<b.size(); i++) fb[i] = b[i] % (int)p;
+	uint32_t * x = (uint32_t *)fa.data(), * y = (uint32_t *)fb.data();
+	forward(x, n);
+	forward(y, n);
+	// the pointwise Montgomery products carry a factor 2^-32, which the
+	// scale of the inverse transform takes back out
+	for(long i=0; i<n; i++) x[i] = mul(x[i], y[i]);
+	backward(x, n, toMontgomery(toMontgomery(Modulus(p).inverse(n))));
+	fa.resize(size);
+	out.swap(fa);
+	return true;
+    }
+
+    // a context per prime, for each thread
+    NTT & ntt_context(int prime)
+    {
+	thread_local std::map<int, NTT> contexts;
+	std::map<int, NTT>::iterator it = contexts.find(prime);
+	if(it==contexts.end()) it = contexts.insert(std::make_pair(prime, NTT(prime))).first;
+	return it->second;
+    }
+
+    bool ntt(vector<int> & a, bool inverse, int prime)
+    {
+	long n = a.size();
+	if(prime<2 || n==0 || (n&(n-1)) || (prime-1)%n) return false;
+	if(n==1) return true;
+	return ntt_context(prime).transform(a, inverse);
+    }
+
+    void convolve(const vector<int> & a, const vector<int> & b, vector<int> & out, int modulus)
+    {
+	if(modulus==0 || a.empty() || b.empty())
+	{
+	    out.clear();
+	    return;
+	}
+	int m = std::abs(modulus);
+	Modulus mod(m);
+	size_t size = a.size()+b.size()-1;
+
+	if(std::min(a.size(), b.size()) < (size_t)CONVOLVE_SCHOOLBOOK)
+	{
+	    vector<int> result(size, 0);
+	    for(size_t i=0; i<a.size(); i++)
+	    {
+		for(size_t j=0; j<b.size(); j++)
+		{
+		    int term = mod.mul(a[i], b[j]);
+		    result[i+j] = result[i+j] >= m-term ? result[i+j]-(m-term) : result[i+j]+term;
+		}
+	    }
+	    out.swap(result);
+	    return;
+	}
+
+	for(int i=0; i<3; i++)
+	{
+	    if(m==NTT_PRIMES[i] && (long)size <= ntt_context(m).maxSize() && ntt_context(m).multiply(a, b, out)) return;
+	}
+
+	// longer products are split into blocks of half the largest size that
+	// all three primes transform, and the partial products are summed
+	if(size > (size_t)NTT_MAX_SIZE)
+	{
+	    const size_t block = NTT_MAX_SIZE/2;
+	    vector<int> result(size, 0), x, y, part;
+	    for(size_t i=0; i<a.size(); i += block)
+	    {
+		x.assign(a.begin()+i, a.begin()+std::min(i+block, a.size()));
+		for(size_t j=0; j<b.size(); j += block)
+		{
+		    y.assign(b.begin()+j, b.begin()+std::min(j+block, b.size()));
+		    convolve(x, y, part, m);
+		    for(size_t k=0; k<part.size(); k++)
+		    {
+			int & r = result[i+j+k];
+			r = r >= m-part[k] ? r-(m-part[k]) : r+part[k];
+		    }
+		}
+	    }
+	    out.swap(result);
+	    return;
+	}
+
+	// exact modulo p0*p1*p2, then Garner: x = x0 + x1*p0 + x2*p0*p1.
+	// All three primes take transforms of NTT_MAX_SIZE terms.
+	vector<int> r0, r1, r2;
+	if(!ntt_context(NTT_PRIMES[0]).multiply(a, b, r0)
+	   || !ntt_context(NTT_PRIMES[1]).multiply(a, b, r1)
+	   || !ntt_context(NTT_PRIMES[2]).multiply(a, b, r2))
+	{
+	    out.clear();
+	    return;
+	}
+	const long p0 = NTT_PRIMES[0], p1 = NTT_PRIMES[1], p2 = NTT_PRIMES[2];
+	const long inv01 = modularInverse(p0, p1), inv012 = modularInverse(p0*p1 % p2, p2);
+	const long p01 = p0*p1 % m;
+	out.resize(size);
+	for(size_t i=0; i<size; i++)
+	{
+	    long x0 = r0[i];
+	    long x1 = ((r1[i]-x0) % p1 + p1) % p1 * inv01 % p1;
+	    long x2 = ((r2[i]-x0-x1*p0) % p2 + p2) % p2 * inv012 % p2;
+	    out[i] = (int)(((x0 + x1*p0) % m + x2 * p01) % m);
+	}
+    }
+
+    bool shiftSamples(const vector<int> & values, long m, vector<int> & out, int prime)
+    {
+	if(values.empty())
+	{
+	    out.clear();
+	    return true;
+	}
+	long d = values.size()-1;
+	if(d>=prime) return false;
+	Modulus mod(prime);
+
+	// t[j] = m-d+j and its inverse, by one inversion of the product
+	vector<int> t(2*d+1), inverses(2*d+1);
+	int product = 1;
+	for(long j=0; j<=2*d; j++)
+	{
+	    t[j] = mod.reduce(m-d+j);
+	    if(t[j]==0) return false;
+	    inverses[j] = product;
+	    product = mod.mul(product, t[j]);
+	}
+	int inverse = mod.inverse(product);
+	for(long j=2*d; j>=0; j--)
+	{
+	    inverses[j] = mod.mul(inverses[j], inverse);
+	    inverse = mod.mul(inverse, t[j]);
+	}
+
+	// a[i] = f(i) / (i! (d-i)! (-1)^(d-i))
+	vector<int> inverseFacts(d+1);
+	int fact = 1;
+	for(long i=1; i<=d; i++) fact = mod.mul(fact, i);
+	inverseFacts[d] = mod.inverse(fact);
+	for(long i=d; i>0; i--) inverseFacts[i-1] = mod.mul(inverseFacts[i], i);
+	vector<int> a(d+1);
+	for(long i=0; i<=d; i++)
+	{
+	    a[i] = mod.mul(mod.mul(values[i] % prime, inverseFacts[i]), inverseFacts[d-i]);
+	    if((d-i)%2 && a[i]) a[i] = prime-a[i];
+	}
+
+	vector<int> c;
+	convolve(a, inverses, c, prime);
+	// window = (m+k-d)...(m+k), slid along k
+	int window = 1;
+	for(long j=0; j<=d; j++) window = mod.mul(window, t[j]);
+	out.resize(d+1);
+	for(long k=0; k<=d; k++)
+	{
+	    out[k] = mod.mul(c[d+k], window);
+	    if(k<d) window = mod.mul(mod.mul(window, t[d+k+1]), inverses[k]);
+	}
+	return true;
+    }
+
+    //Polynomial Inverse, by Newton's iteration b = b*(2 - a*b)
+    bool polyInverse(const vector<int> & a, int n, vector<int> & out, int prime)
+    {
+	out.clear();
+	if(n<=0) return true;
+	Modulus mod(prime);
+	if(a.empty() || a[0] % prime==0) return false;
+	out.assign(1, mod.inverse(a[0]));
+	vector<int> t, e;
+	for(long k=1; k<n; )
+	{
+	    k *= 2;
+	    t.assign(a.begin(), a.begin()+std::min((long)a.size(), k));
+	    convolve(t, out, e, prime);
+	    e.resize(k);
+	    for(long i=0; i<k; i++) e[i] = e[i] ? prime-e[i] : 0;
+	    e[0] = e[0]+2 >= prime ? e[0]+2-prime : e[0]+2;
+	    convolve(out, e, t, prime);
+	    t.resize(k);
+	    out.swap(t);
+	}
+	out.resize(n);
+	return true;
+    }
+
+    //Polynomial Division, by inverting the reversal of the divisor
+    bool polyDivide(const vector<int> & a, const vector<int> & b, vector<int> & quotient, vector<int> & remainder, int prime)
+    {
+	quotient.clear();
+	remainder.clear();
+	long da = a.size(), db = b.size();
+	while(da>0 && a[da-1] % prime==0) da--;
+	while(db>0 && b[db-1] % prime==0) db--;
+	if(db==0) return false;
+	if(da<db)
+	{
+	    remainder.assign(a.begin(), a.begin()+da);
+	    return true;
+	}
+
+	// the quotient has da-db+1 terms, and its reversal is rev(a)/rev(b)
+	long length = da-db+1;
+	vector<int> ra(a.rbegin()+(a.size()-da), a.rend()), rb(b.rbegin()+(b.size()-db), b.rend()), inverse;
+	ra.resize(std::min(da, length));
+	polyInverse(rb, length, inverse, prime);
+	convolve(ra, inverse, quotient, prime);
+	quotient.resize(length);
+	std::reverse(quotient.begin(), quotient.end());
+
+	vector<int> product;
+	vector<int> bTrimmed(b.begin(), b.begin()+db);
+	convolve(bTrimmed, quotient, product, prime);
+	remainder.resize(db-1);
+	for(long i=0; i<db-1; i++)
+	{
+	    int x = a[i] % prime, y = product[i];
+	    remainder[i] = x>=y ? x-y : x-y+prime;
+	}
+	while(!remainder.empty() && remainder.back()==0) remainder.pop_back();
+	while(!quotient.empty() && quotient.back()==0) quotient.pop_back();
+	return true;
+    }
+
+    // inverses[i] = 1/i mod prime for 0 < i < n, by inv(i) = -(p/i) inv(p%i)
+    void poly_inverses(int n, int prime, vector<int> & inverses)
+    {
+	inverses.assign(std::max(n, 2), 0);
+	inverses[1] = 1;
+	for(long i=2; i<n; i++)
+	{
+	    inverses[i] = (int)((long)(prime - prime/i) * inverses[prime%i] % prime);
+	}
+    }
+
+    //Polynomial Logarithm, as the integral of a'/a
+    bool polyLog(const vector<int> & a, int n, vector<int> & out, int prime)
+    {
+	out.clear();
+	if(n<=0) return true;
+	if(a.empty() || a[0] % prime!=1 % prime || n>prime) return false;
+	vector<int> derivative, inverse, quotient, inverses;
+	Modulus mod(prime);
+	for(long i=1; i<(long)a.size() && i<n; i++) derivative.push_back(mod.mul(a[i] % prime, (int)i));
+	if(derivative.empty())
+	{
+	    out.assign(n, 0);
+	    return true;
+	}
+	polyInverse(a, n, inverse, prime);
+	convolve(derivative, inverse, quotient, prime);
+	quotient.resize(n);
+	poly_inverses(n, prime, inverses);
+	out.assign(n, 0);
+	for(long i=1; i<n; i++) out[i] = mod.mul(quotient[i-1], inverses[i]);
+	return true;
+    }
+
+    //Polynomial Exponential, by Newton's iteration f = f*(1 - log(f) + a)
+    bool polyExp(const vector<int> & a, int n, vector<int> & out, int prime)
+    {
+	out.clear();
+	if(n<=0) return true;
+	if((!a.empty() && a[0] % prime!=0) || n>prime) return false;
+	out.assign(1, 1 % prime);
+	vector<int> logarithm, h;
+	for(long k=1; k<n; )
+	{
+	    k *= 2;
+	    polyLog(out, (int)std::min(k, (long)prime), logarithm, prime);
+	    h.assign(k, 0);
+	    for(long i=0; i<k; i++)
+	    {
+		int x = i<(long)a.size() ? a[i] % prime : 0, y = i<(long)logarithm.size() ? logarithm[i] : 0;
+		h[i] = x>=y ? x-y : x-y+prime;
+	    }
+	    h[0] = (h[0]+1) % prime;
+	    convolve(out, h, logarithm, prime);
+	    logarithm.resize(k);
+	    out.swap(logarithm);
+	}
+	out.resize(n);
+	return true;
+    }
+
+}
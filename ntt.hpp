@@ -0,0 +1,144 @@
+/*
+ * This file contains the number theoretic transform and the polynomial
+ * arithmetic built on it: products of polynomials modulo a prime, or any
+ * modulus, in O(n log n) time.
+ */
+
+
+#ifndef BR_NTT_HPP
+#define BR_NTT_HPP
+
+#include<vector>
+#include<cstdint>
+
+namespace nt
+{
+    /**
+     * NTT Context
+     * The number theoretic transform mod one prime p, the discrete Fourier
+     * transform over the integers mod p with a primitive root of unity of
+     * order n, for n a power of 2 dividing p-1.  The tables of roots of unity
+     * (in Montgomery form) are kept and grown as bigger sizes are asked for,
+     * so a context pays for its primitive root and tables once.
+     * The transform is iterative and in place, two radix-2 levels at a time
+     * (radix-4 butterflies, with one radix-2 level if log2(n) is odd), each
+     * level a pass of contiguous butterflies.  The butterflies use Montgomery
+     * multiplication, 16 or 8 lanes at a time with AVX-512 or AVX2 when the
+     * CPU supports them (checked at run time).
+     *
+     * CONSTRUCTOR PARAMETERS: the prime, as int
+     * Notes: the prime must be odd and below 2^31.  All residues lie in
+     * [0, prime).  The forward transform takes the coefficients in order to
+     * the values in bit-reversed order, and the inverse one takes them back
+     * (including the division by n), so convolutions need no bit reversal.
+     * transform returns false, leaving a unchanged, if a.size() is not a
+     * power of 2 dividing prime-1.  Not safe to share between threads, as the
+     * tables grow on demand.
+     */
+    class NTT
+    {
+    public:
+	explicit NTT(int prime);
+
+	// the prime
+	int prime() const { return p; }
+
+	// the largest power of 2 dividing prime-1, the largest transform size
+	long maxSize() const { return largest; }
+
+	// the transform, or its inverse, in place
+	bool transform(std::vector<int> & a, bool inverse);
+
+	// out = a*b mod prime, if the product fits in maxSize() terms
+	bool multiply(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out);
+
+    private:
+	void grow(long size);
+	void forward(uint32_t * a, long n) const;
+	void backward(uint32_t * a, long n, uint32_t scale) const;
+	uint32_t mul(uint32_t a, uint32_t b) const;
+	uint32_t toMontgomery(uint32_t a) const { return mul(a, r2); }
+
+	uint32_t p, mInverse, one, r2;
+	long largest;
+	int root;
+	// roots[L+j] = w^j for a primitive (2L)th root of unity w, and j < L;
+	// imaginary is a primitive 4th root of unity
+	std::vector<uint32_t> roots, inverseRoots;
+	uint32_t imaginary, inverseImaginary;
+    };
+
+    /**
+     * Number Theoretic Transform
+     * PARAMETERS: a vector (a) of residues mod prime, whether to do the
+     * inverse transform (inverse), and the prime, as int
+     * RETURN: true if the transform was done: a.size() must be a power of 2
+     * that divides prime-1.  false otherwise, and a is left unchanged.
+     * Notes: This function changes the vector parameter!  Same as
+     * NTT::transform, with a context per prime cached for each thread.
+     */
+    bool ntt(std::vector<int> & a, bool inverse, int prime);
+
+    /**
+     * Convolution (Polynomial Multiplication)
+     * PARAMETERS: two vectors (a, b) of residues, a vector (out) to hold the
+     * result, and the modulus, as int
+     * RETURN: Nothing, but out[k] is the sum of a[i]*b[k-i] mod the modulus,
+     * for k < a.size()+b.size()-1.
+     * Notes: This function changes the vector parameter!  Entries of a and b
+     * must lie in [0, modulus).  The modulus is converted to its absolute
+     * value, and out is left empty if it is 0 or either input is empty.  The
+     * product is done exactly modulo the three NTT primes 998244353,
+     * 167772161 and 469762049 and recombined by Garner's algorithm, which is
+     * exact for results of up to 2^23 terms; when the modulus is one of those
+     * primes, a single transform does, up to that prime's maxSize().  Longer
+     * products are cut into blocks of 2^22 terms of each input, whose partial
+     * products are added up.  Short inputs use the schoolbook product.  A
+     * product of two 10^6 term sequences takes about 0.1 seconds modulo an
+     * NTT prime, and three times that modulo any other.
+     */
+    void convolve(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & out, int modulus);
+
+    /**
+     * Sample Shifting
+     * Given the values f(0), f(1), ..., f(d) of a polynomial of degree at
+     * most d, computes f(m), f(m+1), ..., f(m+d) by Lagrange interpolation,
+     *     f(m+k) = prod_j (m+k-j) * sum_i f(i) / ((m+k-i) i! (d-i)! (-1)^(d-i)),
+     * where the sum is a convolution.
+     * PARAMETERS: a vector (values) of f(0), ..., f(d), the shift (m), a
+     * vector (out) to hold the results, and the prime, as int
+     * RETURN: true if the shift was done, with out[k] = f(m+k).  false if
+     * one of m-d, ..., m+d is 0 mod prime, or d >= prime.
+     * Notes: This function changes the vector parameter!  values and out may
+     * be the same vector.  Takes one convolution of size 3d.
+     */
+    bool shiftSamples(const std::vector<int> & values, long m, std::vector<int> & out, int prime);
+
+
+    /**
+     * Polynomial Arithmetic
+     * Power series and polynomials modulo a prime, as vectors of residues in
+     * [0, prime), lowest degree first, built on convolve: so any prime works,
+     * and the NTT primes are fastest.  Newton's iteration doubles the number
+     * of correct terms at each step, so all of these take O(n log n) time.
+     *   polyInverse: out = 1/a mod x^n.  Needs a[0] != 0.
+     *   polyDivide: a = quotient*b + remainder, with deg(remainder) < deg(b),
+     *     by inverting the reversal of b.  Needs b != 0.  Both results have
+     *     their leading zeros trimmed (the zero polynomial is empty).
+     *   polyLog: out = log(a) mod x^n, the integral of a'/a.  Needs a[0] = 1
+     *     and n <= prime.
+     *   polyExp: out = exp(a) mod x^n, by f = f*(1 - log(f) + a).  Needs
+     *     a[0] = 0 and n <= prime.
+     * RETURN: true, or false if the requirement does not hold, in which case
+     * the outputs are left empty.
+     * Notes: These functions change their vector parameters!  The outputs
+     * may not be the same vectors as the inputs.
+     */
+    bool polyInverse(const std::vector<int> & a, int n, std::vector<int> & out, int prime);
+    bool polyDivide(const std::vector<int> & a, const std::vector<int> & b, std::vector<int> & quotient, std::vector<int> & remainder, int prime);
+    bool polyLog(const std::vector<int> & a, int n, std::vector<int> & out, int prime);
+    bool polyExp(const std::vector<int> & a, int n, std::vector<int> & out, int prime);
+
+}
+
+#endif
@@ -4,6 +4,10 @@
 #include<vector>
 #include<cmath>
 #include<map>
+#include<cstdint>
+#include<thread>
+#include<mutex>
+#include<cstdlib>
 #include "numthy/primes.hpp"
 
 using std::vector;
@@ -71,6 +75,483 @@ namespace nt
 	return listVector;
     }
 
+    /* Segmented sieve engine.
+     * The segmented sieves only store odd numbers: index j stands for the
+     * odd number 2j+1.  basePrimes holds the odd primes needed to sieve the
+     * range, and next[i] holds the index of the next odd multiple of
+     * basePrimes[i] that still has to be crossed off, so each segment picks
+     * up where the previous one stopped.
+     */
+
+    // odd primes p with p*p < max
+    vector<int> segmentedSieve_basePrimes(uint64_t max)
+    {
+	// smallest limit with limit*limit >= max
+	uint64_t limit = (uint64_t)sqrt((double)max);
+	while(limit*limit < max) limit++;
+	while(limit > 2 && (limit-1)*(limit-1) >= max) limit--;
+	if(limit < 2) limit = 2;
+	vector<int> basePrimes = segmentedPrimes((int)limit);
+	if(!basePrimes.empty()) basePrimes.erase(basePrimes.begin());
+	return basePrimes;
+    }
+
+    // index of the first odd multiple of p that is at least p*p and at
+    // least the odd number with index first
+    inline uint64_t segmentedSieve_firstMultiple(uint64_t first, uint64_t p)
+    {
+	uint64_t low = 2*first+1;
+	uint64_t m = p*p;
+	if(m < low)
+	{
+	    m = (low+p-1)/p*p;
+	    if(!(m&1)) m += p;
+	}
+	return (m-1)/2;
+    }
+
+    // point next at the first multiple to cross off for each of the first
+    // primeCount base primes
+    void segmentedSieve_init(uint64_t first, const vector<int> & basePrimes, size_t primeCount, vector<uint64_t> & next)
+    {
+	next.resize(primeCount);
+	for(size_t i=0; i<primeCount; i++)
+	{
+	    next[i] = segmentedSieve_firstMultiple(first, basePrimes[i]);
+	}
+    }
+
+    // sieve the odd numbers with indices [first, first+length) into seg,
+    // using the first primeCount base primes
+    void segmentedSieve_cross(char * seg, uint64_t first, int length, const vector<int> & basePrimes, size_t primeCount, vector<uint64_t> & next)
+    {
+	uint64_t end = first+length;
+	std::fill(seg, seg+length, 1);
+
+	for(size_t i=0; i<primeCount; i++)
+	{
+	    if(next[i] >= end) continue;
+	    uint64_t p = basePrimes[i];
+	    uint64_t k = next[i]-first;
+	    for(; k<(uint64_t)length; k += p) seg[k] = 0;
+	    next[i] = first+k;
+	}
+    }
+
+    // call visit(n) in increasing order for every odd prime n in [low, high),
+    // using the caller's scratch buffers; segment.size() is the segment size
+    template<class Visit>
+    void segmentedSieve_run(uint64_t low, uint64_t high, vector<char> & segment, vector<uint64_t> & next, const vector<int> & basePrimes, Visit visit)
+    {
+	uint64_t first = low/2, end = high/2;
+	if(first >= end) return;
+	segmentedSieve_init(first, basePrimes, basePrimes.size(), next);
+
+	for(; first<end; first += segment.size())
+	{
+	    int length = (int)std::min<uint64_t>(segment.size(), end-first);
+	    segmentedSieve_cross(segment.data(), first, length, basePrimes, basePrimes.size(), next);
+	    for(int k=0; k<length; k++)
+	    {
+		if(segment[k] && first+k > 0) visit(2*(first+k)+1);
+	    }
+	}
+    }
+
+    template<class Visit>
+    void segmentedSieve_run(uint64_t low, uint64_t high, int segmentSize, const vector<int> & basePrimes, Visit visit)
+    {
+	if(segmentSize<1) segmentSize = DEFAULT_SEGMENT_SIZE;
+	vector<char> segment(segmentSize);
+	vector<uint64_t> next;
+	segmentedSieve_run(low, high, segment, next, basePrimes, visit);
+    }
+
+    // Segmented Sieve of Eratosthenes
+    void segmentedPrimeSieve(int max, vector<bool> & sieve, int segmentSize)
+    {
+	if(max<=0) return;
+	if((size_t)max>sieve.size()) sieve.resize(max);
+	std::fill(sieve.begin(), sieve.begin()+max, false);
+	if(max>2) sieve[2] = true;
+
+	vector<int> basePrimes = segmentedSieve_basePrimes(max);
+	segmentedSieve_run(0, max, segmentSize, basePrimes,
+			   [&](uint64_t n) { sieve[n] = true; });
+	return;
+    }
+
+    // Segmented Sieve of Eratosthenes with list of primes
+    vector<int> segmentedPrimes(int max, int segmentSize)
+    {
+	vector<int> pr;
+	if(max<=2) return pr;
+	// pi(x) < 1.26 x/ln(x), so this avoids any reallocation
+	pr.reserve(max>10 ? (size_t)(1.26*max/std::log((double)max)) : 4);
+	pr.push_back(2);
+
+	vector<int> basePrimes = segmentedSieve_basePrimes(max);
+	segmentedSieve_run(0, max, segmentSize, basePrimes,
+			   [&](uint64_t n) { pr.push_back((int)n); });
+	return pr;
+    }
+
+    /* Prime bitmap.
+     * Bit 8b+j of word w stands for the integer 30*(8w+b) + wheel[j].
+     */
+    static const int primeBitmap_wheel[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+    // bit number of each residue mod 30, or -1 if not coprime to 30
+    static const int primeBitmap_bit[30] = {-1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1, -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7};
+    // distance to the next residue coprime to 30
+    static const int primeBitmap_skip[30] = {1, 0, 5, 4, 3, 2, 1, 0, 3, 2, 1, 0, 1, 0, 3, 2, 1, 0, 1, 0, 3, 2, 1, 0, 5, 4, 3, 2, 1, 0};
+
+    // cross off the multiples of basePrimes in words [firstWord, lastWord);
+    // words points at word firstWord
+    void primeBitmap_sieve(uint64_t * words, long firstWord, long lastWord, const vector<int> & basePrimes)
+    {
+	long firstBlock = 8*firstWord, lastBlock = 8*lastWord;
+	std::fill(words, words+(lastWord-firstWord), ~(uint64_t)0);
+	if(firstWord==0) words[0] &= ~(uint64_t)1; // 1 is not prime
+
+	for(size_t i=0; i<basePrimes.size(); i++)
+	{
+	    long p = basePrimes[i];
+	    if(p < 7) continue;
+	    if(p*p >= 30*lastBlock) break;
+
+	    // the first multiple p*q to cross off has q coprime to 30
+	    long q = std::max(p, (30*firstBlock+p-1)/p);
+	    q += primeBitmap_skip[q%30];
+
+	    // the next 8 multiples p*q with q coprime to 30; each later one is
+	    // 30p further on, which is exactly p blocks
+	    long block[8];
+	    int shift[8];
+	    int j = primeBitmap_bit[q%30];
+	    long base = q-q%30;
+	    for(int t=0; t<8; t++)
+	    {
+		long n = p*(base+primeBitmap_wheel[j]);
+		block[t] = n/30;
+		shift[t] = primeBitmap_bit[n%30];
+		if(++j == 8)
+		{
+		    j = 0;
+		    base += 30;
+		}
+	    }
+
+	    for(long offset = 0; ; offset += p)
+	    {
+		for(int t=0; t<8; t++)
+		{
+		    long b = block[t]+offset;
+		    if(b >= lastBlock) goto nextPrime;
+		    words[(b>>3)-firstWord] &= ~((uint64_t)1 << ((b&7)*8+shift[t]));
+		}
+	    }
+	nextPrime: ;
+	}
+    }
+
+    PrimeBitmap::PrimeBitmap() : max(0) {}
+
+    /* Work-stealing pool for the parallel sieves.
+     * Runs work(thread, task) for every task in [0, tasks).  Each thread
+     * starts with its own contiguous run of tasks, taken from the front; a
+     * thread with nothing left steals the back half of another thread's run.
+     */
+    template<class Work>
+    void parallelSieve_run(long tasks, int threads, Work work)
+    {
+	if(threads<1) threads = std::max(1u, std::thread::hardware_concurrency());
+	if(threads>tasks) threads = std::max(1L, tasks);
+	if(threads==1)
+	{
+	    for(long task=0; task<tasks; task++) work(0, task);
+	    return;
+	}
+
+	struct Run
+	{
+	    std::mutex lock;
+	    long begin, end;
+	};
+	vector<Run> runs(threads);
+	for(int t=0; t<threads; t++)
+	{
+	    runs[t].begin = tasks*t/threads;
+	    runs[t].end = tasks*(t+1)/threads;
+	}
+
+	auto worker = [&](int t)
+	{
+	    while(true)
+	    {
+		long task = -1;
+		{
+		    std::lock_guard<std::mutex> guard(runs[t].lock);
+		    if(runs[t].begin < runs[t].end) task = runs[t].begin++;
+		}
+		if(task >= 0)
+		{
+		    work(t, task);
+		    continue;
+		}
+
+		// own run is empty: steal from the first thread with work left
+		long begin = 0, end = 0;
+		for(int k=1; k<threads && begin==end; k++)
+		{
+		    Run & victim = runs[(t+k)%threads];
+		    std::lock_guard<std::mutex> guard(victim.lock);
+		    long left = victim.end-victim.begin;
+		    if(left > 0)
+		    {
+			end = victim.end;
+			begin = victim.end -= (left+1)/2;
+		    }
+		}
+		if(begin==end) return;
+
+		std::lock_guard<std::mutex> guard(runs[t].lock);
+		runs[t].begin = begin;
+		runs[t].end = end;
+	    }
+	};
+
+	vector<std::thread> pool;
+	for(int t=1; t<threads; t++) pool.push_back(std::thread(worker, t));
+	worker(0);
+	for(size_t t=0; t<pool.size(); t++) pool[t].join();
+    }
+
+    PrimeBitmap::PrimeBitmap(long max, int segmentSize, int threads) : max(max)
+    {
+	if(max <= 0)
+	{
+	    this->max = 0;
+	    return;
+	}
+	long blocks = (max+29)/30;
+	long words = (blocks+7)/8;
+	bits.resize(words);
+	long segmentWords = std::max(1, segmentSize/8);
+
+	// segments cover disjoint words, so they can be sieved in any order
+	vector<int> basePrimes = segmentedSieve_basePrimes(max);
+	long segments = (words+segmentWords-1)/segmentWords;
+	parallelSieve_run(segments, threads, [&](int, long segment)
+	{
+	    long w = segment*segmentWords;
+	    primeBitmap_sieve(bits.data()+w, w, std::min(w+segmentWords, words), basePrimes);
+	});
+
+	// clear everything at or past max
+	for(long b = (max-1)/30; b < 8*words; b++)
+	{
+	    for(int j=0; j<8; j++)
+	    {
+		if(30*b+primeBitmap_wheel[j] >= max)
+		    bits[b>>3] &= ~((uint64_t)1 << ((b&7)*8+j));
+	    }
+	}
+    }
+
+    bool PrimeBitmap::isPrime(long n) const
+    {
+	if(n < 0 || n >= max) return false;
+	if(n < 7) return n==2 || n==3 || n==5;
+	int j = primeBitmap_bit[n%30];
+	if(j < 0) return false;
+	long b = n/30;
+	return (bits[b>>3] >> ((b&7)*8+j)) & 1;
+    }
+
+    long PrimeBitmap::count() const
+    {
+	long total = (max>2) + (max>3) + (max>5);
+	for(size_t w=0; w<bits.size(); w++)
+	{
+	    total += __builtin_popcountll(bits[w]);
+	}
+	return total;
+    }
+
+    // Sieve of Eratosthenes with list of primes, bitmap version
+    vector<int> primes(int max, PrimeBitmap & sieve)
+    {
+	sieve = PrimeBitmap(max);
+	return vectorFromSieve(sieve);
+    }
+
+    // Vector of primes from bitmap
+    vector<int> vectorFromSieve(const PrimeBitmap & sieve)
+    {
+	vector<int> listVector;
+	listVector.reserve(sieve.count());
+	sieve.forEachPrime([&](long p) { listVector.push_back((int)p); });
+	return listVector;
+    }
+
+    // Parallel Sieve of Eratosthenes with list of primes
+    vector<int> parallelPrimes(int max, int threads, int segmentSize)
+    {
+	vector<int> pr;
+	if(max<=2) return pr;
+	if(segmentSize<1) segmentSize = DEFAULT_SEGMENT_SIZE;
+	if(threads<1) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// each task sieves a chunk of consecutive segments
+	const uint64_t chunk = 16*(uint64_t)segmentSize;
+	uint64_t oddCount = max/2;
+	long tasks = (oddCount+chunk-1)/chunk;
+
+	vector<int> basePrimes = segmentedSieve_basePrimes(max);
+	vector<vector<int> > found(tasks);
+	vector<vector<char> > segments(threads, vector<char>(segmentSize));
+	vector<vector<uint64_t> > nexts(threads);
+
+	parallelSieve_run(tasks, threads, [&](int t, long task)
+	{
+	    uint64_t low = 2*(task*chunk), high = std::min<uint64_t>(2*(task+1)*chunk, max);
+	    vector<int> & out = found[task];
+	    segmentedSieve_run(low, high, segments[t], nexts[t], basePrimes,
+			       [&](uint64_t n) { out.push_back((int)n); });
+	});
+
+	// concatenate the chunks in order
+	size_t total = 1;
+	for(long task=0; task<tasks; task++) total += found[task].size();
+	pr.reserve(total);
+	pr.push_back(2);
+	for(long task=0; task<tasks; task++)
+	{
+	    pr.insert(pr.end(), found[task].begin(), found[task].end());
+	    vector<int>().swap(found[task]);
+	}
+	return pr;
+    }
+
+    /* Range sieve engine.
+     * Calls visit(n) in increasing order for every odd prime n in [lo, hi).
+     * The whole window is kept in memory.  Base primes below the segment
+     * size are sieved one segment at a time.  The larger ones (up to 10^9 for
+     * a window near 10^18) hit a segment at most once, so each of them just
+     * crosses off its few multiples in a single pass over the window, with
+     * no per-prime state kept.
+     */
+    template<class Visit>
+    void rangeSieve_run(uint64_t lo, uint64_t hi, int segmentSize, Visit visit)
+    {
+	if(segmentSize<1) segmentSize = DEFAULT_SEGMENT_SIZE;
+	uint64_t first = lo/2, end = hi/2;
+	if(first >= end) return;
+	uint64_t size = end-first;
+	vector<char> window(size);
+
+	vector<int> basePrimes = segmentedSieve_basePrimes(hi);
+	size_t small = std::lower_bound(basePrimes.begin(), basePrimes.end(), segmentSize) - basePrimes.begin();
+	vector<uint64_t> next;
+	segmentedSieve_init(first, basePrimes, small, next);
+
+	for(uint64_t offset=0; offset<size; offset += segmentSize)
+	{
+	    int length = (int)std::min<uint64_t>(segmentSize, size-offset);
+	    segmentedSieve_cross(window.data()+offset, first+offset, length, basePrimes, small, next);
+	}
+	for(size_t i=small; i<basePrimes.size(); i++)
+	{
+	    uint64_t p = basePrimes[i];
+	    for(uint64_t k = segmentedSieve_firstMultiple(first, p)-first; k<size; k += p)
+	    {
+		window[k] = 0;
+	    }
+	}
+
+	for(uint64_t k=0; k<size; k++)
+	{
+	    if(window[k] && first+k > 0) visit(2*(first+k)+1);
+	}
+    }
+
+    // Range Sieve
+    void rangeSieve(uint64_t lo, uint64_t hi, vector<bool> & sieve, int segmentSize)
+    {
+	if(hi<=lo || hi>RANGE_SIEVE_MAX) return;
+	uint64_t size = hi-lo;
+	if(size>sieve.size()) sieve.resize(size);
+	std::fill(sieve.begin(), sieve.begin()+size, false);
+	if(lo<=2 && hi>2) sieve[2-lo] = true;
+
+	rangeSieve_run(lo, hi, segmentSize, [&](uint64_t n) { sieve[n-lo] = true; });
+	return;
+    }
+
+    // Range Sieve with list of primes
+    vector<uint64_t> primesInRange(uint64_t lo, uint64_t hi, int segmentSize)
+    {
+	vector<uint64_t> pr;
+	if(hi<=lo || hi>RANGE_SIEVE_MAX) return pr;
+	if(lo<=2 && hi>2) pr.push_back(2);
+
+	rangeSieve_run(lo, hi, segmentSize, [&](uint64_t n) { pr.push_back(n); });
+	return pr;
+    }
+
+    // Prime Generator
+    PrimeGenerator::PrimeGenerator(uint64_t start, int segmentSize)
+	: pendingTwo(start<=2), segment(segmentSize<1 ? DEFAULT_SEGMENT_SIZE : segmentSize),
+	  first(start/2), length(0), position(0), baseLimit(0)
+    {
+    }
+
+    uint64_t PrimeGenerator::next()
+    {
+	if(pendingTwo)
+	{
+	    pendingTwo = false;
+	    return 2;
+	}
+	while(true)
+	{
+	    while(position < length)
+	    {
+		int k = position++;
+		if(segment[k] && first+k > 0) return 2*(first+k)+1;
+	    }
+	    if(!nextSegment()) return 0;
+	}
+    }
+
+    // sieve the segment following the current one
+    bool PrimeGenerator::nextSegment()
+    {
+	first += length;
+	position = 0;
+	length = 0;
+	uint64_t end = std::min<uint64_t>(first+segment.size(), RANGE_SIEVE_MAX/2);
+	if(first >= end) return false;
+	length = (int)(end-first);
+
+	// extend the base primes, quadrupling the limit so that the work
+	// spent recomputing them stays O(sqrt(n))
+	if(2*end > baseLimit)
+	{
+	    baseLimit = std::min(std::max(2*end, 4*baseLimit), RANGE_SIEVE_MAX);
+	    size_t known = basePrimes.size();
+	    basePrimes = segmentedSieve_basePrimes(baseLimit);
+	    nextMultiple.resize(basePrimes.size());
+	    for(size_t i=known; i<basePrimes.size(); i++)
+	    {
+		nextMultiple[i] = segmentedSieve_firstMultiple(first, basePrimes[i]);
+	    }
+	}
+
+	segmentedSieve_cross(segment.data(), first, length, basePrimes, basePrimes.size(), nextMultiple);
+	return true;
+    }
+
     // Smallest Prime Factor Sieve
     void smallestPrimeFactors(int max, vector<bool> & sieve, vector<int> & smallPrimeFactors)
     {
@@ -179,6 +660,79 @@ namespace nt
     }
 
 
+    // Compact Smallest Prime Factor Table
+    SmallestFactorTable::SmallestFactorTable() : max(0) {}
+
+    SmallestFactorTable::SmallestFactorTable(int max) : max(std::max(max, 0))
+    {
+	primes = segmentedSieve_basePrimes(this->max);
+	entries.assign(this->max/2, 0);
+
+	/* Sieve one segment at a time.  Within a segment the primes go in
+	 * decreasing order, so the smallest prime factor is written last.
+	 */
+	vector<uint64_t> next;
+	segmentedSieve_init(0, primes, primes.size(), next);
+	uint64_t end = entries.size();
+	for(uint64_t first = 0; first < end; first += DEFAULT_SEGMENT_SIZE)
+	{
+	    uint64_t last = std::min<uint64_t>(first+DEFAULT_SEGMENT_SIZE, end);
+	    for(size_t i = primes.size(); i-- > 0; )
+	    {
+		uint64_t k = next[i];
+		for(; k<last; k += primes[i]) entries[k] = i+1;
+		next[i] = k;
+	    }
+	}
+    }
+
+    int SmallestFactorTable::smallestPrimeFactor(int n) const
+    {
+	if(n<2) return n;
+	if(!(n&1)) return 2;
+	int entry = entries[n>>1];
+	return entry ? primes[entry-1] : n;
+    }
+
+    Factorization SmallestFactorTable::factorize(int n) const
+    {
+	Factorization result;
+	if(n<2) return result;
+
+	int twos = __builtin_ctz(n);
+	if(twos)
+	{
+	    result.add(2, twos);
+	    n >>= twos;
+	}
+	while(n>1)
+	{
+	    int entry = entries[n>>1];
+	    if(!entry)
+	    {
+		result.add(n, 1);
+		break;
+	    }
+	    int p = primes[entry-1], k = 0;
+	    do
+	    {
+		n /= p;
+		k++;
+	    } while(n%p==0);
+	    result.add(p, k);
+	}
+	return result;
+    }
+
+    void SmallestFactorTable::factorize(const vector<int> & numbers, vector<Factorization> & factorizations) const
+    {
+	factorizations.resize(numbers.size());
+	for(size_t i=0; i<numbers.size(); i++)
+	{
+	    factorizations[i] = factorize(numbers[i]);
+	}
+    }
+
     // Euler's Totient Function Sieve
     void eulerTotientSieve(int max, vector<bool> & sieve, vector<int> & totients)
     {
@@ -218,6 +772,17 @@ namespace nt
     }
 
     
+    void factorizeWindow(long lo, long hi, vector<Factorization> & factorizations)
+    {
+	lo = std::max(lo, 0L);
+	factorizations.assign(std::max(hi-lo, 0L), Factorization());
+	windowSieve(lo, hi, [&](long i, long p, int k, long /*pk*/)
+	{
+	    factorizations[i].add(p, k);
+	});
+    }
+
+    
     //methods to compute PI(n) using Lehmer's method.  Somehow still slowish...
     long countPrimes_phi(long max, long primeNo, map<pair<long, int>, long> & memo, vector<int> & primes)
     {
@@ -231,10 +796,35 @@ namespace nt
 	return ans;
     }
 
-    long countPrimes_helper(long max, vector<int> & primes, map<long, long> & memo)
+    // the memo accessors countPrimes_helper is written against, so one
+    // recursion serves both memo types.  find returns -1 on a miss.
+    long countPrimes_find(const map<long, long> & memo, long max)
+    {
+	map<long, long>::const_iterator it = memo.find(max);
+	return it==memo.end() ? -1 : it->second;
+    }
+
+    void countPrimes_store(map<long, long> & memo, long max, long count)
+    {
+	memo[max] = count;
+    }
+
+    long countPrimes_find(const PrimeCountMemo & memo, long max)
+    {
+	return memo.find(max);
+    }
+
+    void countPrimes_store(PrimeCountMemo & memo, long max, long count)
+    {
+	memo.store(max, count);
+    }
+
+    template<class Memo>
+    long countPrimes_helper(long max, vector<int> & primes, Memo & memo)
     {
 	if(max<2) return 0;
-	if(memo.count(max)) return memo[max];
+	long known = countPrimes_find(memo, max);
+	if(known>=0) return known;
 	if(max <= primes[primes.size()-1])
 	{
 	    int mn = 0, mx = primes.size()-1, md;
@@ -244,7 +834,7 @@ namespace nt
 		if(primes[md]>max) mx = md-1;
 		else mn = md;
 	    }
-	    memo[max] = mn+1;
+	    countPrimes_store(memo, max, mn+1);
 	    return mn+1;
 	}
 
@@ -274,13 +864,13 @@ namespace nt
 		}
 	    }
 	}
-	memo[max] = ans;
+	countPrimes_store(memo, max, ans);
 	return ans;
     }
 
     long countPrimes(long max, vector<int> & primes)
     {
-	map<long, long> piMemo;
+	PrimeCountMemo piMemo(std::max(max, 0L));
 	return countPrimes_helper(max, primes, piMemo);
     }
 
@@ -289,6 +879,330 @@ namespace nt
 	return countPrimes_helper(max, primes, memo);
     }
 
+    PrimeCountMemo::PrimeCountMemo(long n) : n(n)
+    {
+	sqrtN = (long)sqrt((double)n);
+	while(sqrtN*sqrtN > n) sqrtN--;
+	while((sqrtN+1)*(sqrtN+1) <= n) sqrtN++;
+	small.assign(sqrtN+1, -1);
+	large.assign(sqrtN+1, -1);
+    }
+
+    long countPrimesMemoized(long max, vector<int> & primes, PrimeCountMemo & memo)
+    {
+	return countPrimes_helper(max, primes, memo);
+    }
+
+    /* Prime counting by the Lagarias-Miller-Odlyzko method.
+     * With y = alpha*x^(1/3), a = pi(y) and z = x/y,
+     *   pi(x) = phi(x, a) + a - 1 - P2(x, a),
+     * where P2 counts the numbers up to x with exactly two prime factors,
+     * both above y.  Expanding phi(x, a) with phi(x, b) = phi(x, b-1) -
+     * phi(x/p_b, b-1) leaves the sum of mu(n) phi(x/n, b) over the leaves n
+     * of the recursion: the ordinary leaves (S1), n <= y, which only need
+     * phi(t, c) for the first c = 6 primes and come from a table, and the
+     * special leaves (S2), n = p_b*m with m <= y < n.
+     * The special leaves need phi(v, b-1) for v < z.  The leaves with v < p_b
+     * have phi = 1 (trivial leaves), and those with v < p_b^2 and v <= y have
+     * phi = pi(v)-b+2 (easy leaves), read from a table of pi up to y.  The
+     * rest are found by sieving [1, z] in segments, crossing off one prime
+     * at a time: just before p_b is crossed off, phi(v, b-1) is the count of
+     * survivors up to v, which counters over blocks of the segment return
+     * quickly.  Only odd numbers are stored.
+     * Everything lives in flat arrays of size O(y) or O(segment size).
+     */
+    const int COUNT_PRIMES_SMALL_PRIMES = 6;
+    const long COUNT_PRIMES_PRIMORIAL = 30030;
+    const long COUNT_PRIMES_TOTIENT = 5760;
+    const long COUNT_PRIMES_SIEVE_LIMIT = 1L << 24;
+    const long COUNT_PRIMES_SEGMENT = 1L << 16;
+
+    // floor(sqrt(n)) and floor(cbrt(n)), exactly
+    long countPrimes_sqrt(long n)
+    {
+	long r = (long)sqrt((double)n);
+	while(r*r > n) r--;
+	while((r+1)*(r+1) <= n) r++;
+	return r;
+    }
+
+    long countPrimes_cbrt(long n)
+    {
+	long r = (long)std::cbrt((double)n);
+	while(r*r*r > n) r--;
+	while((r+1)*(r+1)*(r+1) <= n) r++;
+	return r;
+    }
+
+    // floor(n/d) for 0 <= n < 2^53, with nd = n as a double: a floating
+    // point division, which is much faster than an integer one, is off by
+    // at most one, and only upwards
+    inline long countPrimes_divide(long n, double nd, long d)
+    {
+	long q = (long)(nd/d);
+	return q - (q*d > n);
+    }
+
+    /* The survivors of one segment of the sieve for the hard leaves, as a
+     * bitset (bit k for the odd number with index first+k), with the number
+     * of survivors in each block of 1024 bits.  Crossing off a number is
+     * O(1).  Within the pass for one prime, the leaves come in increasing
+     * order of v, so count keeps a cursor: it adds whole blocks from their
+     * counters, then popcounts words up to v.
+     */
+    struct countPrimes_Segment
+    {
+	static const int BLOCK_WORDS = 16;
+	vector<uint64_t> bits;
+	vector<int> counters;
+	long total;
+	// the cursor: the survivors before word position, and before its block
+	long block, blockSum, position, sum;
+
+	void reset(long length)
+	{
+	    bits.assign((COUNT_PRIMES_SEGMENT+63)/64, 0);
+	    for(long w=0; w<length/64; w++) bits[w] = ~(uint64_t)0;
+	    if(length%64) bits[length/64] = ((uint64_t)1 << (length%64)) - 1;
+	}
+
+	// clear bit k; return whether it was set
+	int remove(long k)
+	{
+	    uint64_t bit = (bits[k>>6] >> (k&63)) & 1;
+	    bits[k>>6] &= ~((uint64_t)1 << (k&63));
+	    return (int)bit;
+	}
+
+	void countAll()
+	{
+	    counters.assign(bits.size()/BLOCK_WORDS+1, 0);
+	    total = 0;
+	    for(size_t w=0; w<bits.size(); w++)
+	    {
+		counters[w/BLOCK_WORDS] += __builtin_popcountll(bits[w]);
+		total += __builtin_popcountll(bits[w]);
+	    }
+	}
+
+	void cross(long k)
+	{
+	    int bit = remove(k);
+	    counters[(k>>6)/BLOCK_WORDS] -= bit;
+	    total -= bit;
+	}
+
+	void rewind()
+	{
+	    block = blockSum = position = sum = 0;
+	}
+
+	// the number of survivors with index <= k; k must not decrease
+	// between calls, until the next rewind
+	long count(long k)
+	{
+	    if(k<0) return 0;
+	    long word = k>>6;
+	    if(word/BLOCK_WORDS != block)
+	    {
+		for(; block < word/BLOCK_WORDS; block++) blockSum += counters[block];
+		position = block*BLOCK_WORDS;
+		sum = blockSum;
+	    }
+	    for(; position < word; position++) sum += __builtin_popcountll(bits[position]);
+	    return sum + __builtin_popcountll(bits[word] & (((uint64_t)2 << (k&63)) - 1));
+	}
+    };
+
+    // the special leaves.  leaf[m] = mu(m)*lpf(m) for the squarefree m with
+    // lpf(m) > p_c, 0 otherwise; below[m] is the largest m' <= m with
+    // leaf[m'] != 0.
+    long countPrimes_S2(long x, long y, const vector<int> & primes, const vector<int> & pi, const vector<int> & leaf, const vector<int> & below)
+    {
+	const long c = COUNT_PRIMES_SMALL_PRIMES;
+	long a = primes.size(), z = x/y, sqrtY = countPrimes_sqrt(y);
+	long S2 = 0;
+
+	// trivial and easy leaves; m is prime, as p_b > sqrt(y).  hardMax[b]
+	// is the largest m left for the sieve.  primes is 0-based, so p_b is
+	// primes[b-1].
+	vector<long> hardMax(a, y);
+	for(long b=c+1; b<a; b++)
+	{
+	    long p = primes[b-1];
+	    if(p<=sqrtY) continue;
+	    long easy = std::min(y, p*p-1);
+	    long trivialFrom = std::max(p, std::min(y, x/(p*p)));
+	    long easyFrom = std::max(p, std::min(y, x/(p*(easy+1))));
+	    S2 += a - pi[trivialFrom];
+	    long xp = x/p;
+	    for(long i=pi[easyFrom]; i<pi[trivialFrom]; i++)
+	    {
+		S2 += pi[countPrimes_divide(xp, (double)xp, primes[i])] - b + 2;
+	    }
+	    hardMax[b] = easyFrom;
+	}
+
+	// hard leaves; phi[b] = phi(low-1, b-1), next[b] = index of the next
+	// odd multiple of p_b to cross off
+	vector<long> phi(a, 0), next(a);
+	for(long b=1; b<a; b++) next[b] = (primes[b-1]-1)/2;
+	countPrimes_Segment segment;
+
+	for(long first=0; 2*first<=z; first += COUNT_PRIMES_SEGMENT)
+	{
+	    long low = 2*first, high = std::min(2*(first+COUNT_PRIMES_SEGMENT), z+1);
+	    long length = (high-low)/2, last = first+length;
+	    // leaves n = p_b*m in this segment have m > p_b, so p_b^2 < x/low
+	    long bMax = a-1;
+	    if(low>0) bMax = std::min(bMax, (long)pi[std::min(y, countPrimes_sqrt(x/low))]);
+	    if(bMax<=c) break;
+
+	    segment.reset(length);
+	    for(long b=2; b<=c; b++)
+	    {
+		long p = primes[b-1], j = next[b];
+		for(; j<last; j += p) segment.remove(j-first);
+		next[b] = j;
+	    }
+	    segment.countAll();
+
+	    for(long b=c+1; b<=bMax; b++)
+	    {
+		long p = primes[b-1], xp = x/p;
+		double xd = (double)xp;
+		long mHigh = std::min(hardMax[b], xp/std::max(low, 1L));
+		long mLow = std::max(y/p, xp/high);
+		segment.rewind();
+		if(p<=sqrtY)
+		{
+		    for(long m=below[mHigh]; m>mLow; m=below[m-1])
+		    {
+			if(std::abs(leaf[m])<=p) continue;
+			long v = countPrimes_divide(xp, xd, m);
+			long count = phi[b] + segment.count((v-1)/2-first);
+			S2 += leaf[m]<0 ? count : -count;
+		    }
+		}
+		else if(mHigh>mLow)
+		{
+		    for(long i=pi[mHigh]-1; i>=pi[std::max(p, mLow)]; i--)
+		    {
+			long v = countPrimes_divide(xp, xd, primes[i]);
+			S2 += phi[b] + segment.count((v-1)/2-first);
+		    }
+		}
+		phi[b] += segment.total;
+
+		long j = next[b];
+		for(; j<last; j += p) segment.cross(j-first);
+		next[b] = j;
+	    }
+	}
+	return S2;
+    }
+
+    // P2(x, a): the sum of pi(x/p)-pi(p)+1 over the primes y < p <= sqrt(x).
+    // The pi(x/p) come from a prime bitmap of [0, z], sieved in segments.
+    long countPrimes_P2(long x, long y)
+    {
+	long sqrtX = countPrimes_sqrt(x), z = x/y;
+	if(sqrtX<=y) return 0;
+	vector<int> large = segmentedPrimes((int)sqrtX+1);
+	long a = std::upper_bound(large.begin(), large.end(), (int)y) - large.begin();
+	long B = large.size();
+	// the pi(p)-1 of p = large[k] is k
+	long P2 = -(a+B-1)*(B-a)/2;
+
+	const long segmentWords = 4096;
+	long words = (z/30)/8+1;
+	vector<uint64_t> buffer(segmentWords);
+	vector<int> basePrimes = segmentedSieve_basePrimes(z+1);
+	// primes below 30*8*position: 2, 3, 5 and the bits of earlier words
+	long count = 3, position = 0;
+	long k = B-1;
+	for(long w=0; w<words && k>=a; w += segmentWords)
+	{
+	    long end = std::min(w+segmentWords, words);
+	    primeBitmap_sieve(buffer.data(), w, end, basePrimes);
+	    for(; k>=a && x/large[k] < 240*end; k--)
+	    {
+		long t = x/large[k], block = t/30;
+		for(; position < block/8; position++) count += __builtin_popcountll(buffer[position-w]);
+		// bits of earlier blocks in the word, then residues up to t%30
+		int residues = 0;
+		while(residues<8 && primeBitmap_wheel[residues] <= t%30) residues++;
+		int bits = (block&7)*8 + residues;
+		uint64_t mask = bits==64 ? ~(uint64_t)0 : ((uint64_t)1 << bits)-1;
+		P2 += count + __builtin_popcountll(buffer[position-w] & mask);
+	    }
+	    for(; position < end; position++) count += __builtin_popcountll(buffer[position-w]);
+	}
+	return P2;
+    }
+
+    long countPrimes_lmo(long x, double alpha)
+    {
+	long cbrtX = countPrimes_cbrt(x);
+	long y = std::max(cbrtX+1, std::min((long)(alpha*cbrtX), countPrimes_sqrt(x)));
+
+	vector<int> primes = segmentedPrimes((int)y+1);
+	long a = primes.size();
+	long c = COUNT_PRIMES_SMALL_PRIMES;
+	// leaf[n] = mu(n)*lpf(n): its sign flips once per prime factor, and its
+	// magnitude is 1 until the smallest one is found
+	vector<int> pi(y+1, 0), leaf(y+1, 1), below(y+1, 0);
+	for(long i=0; i<a; i++)
+	{
+	    long p = primes[i];
+	    pi[p] = 1;
+	    for(long k=p; k<=y; k += p)
+	    {
+		if(leaf[k]==1 || leaf[k]==-1) leaf[k] *= p;
+		leaf[k] = -leaf[k];
+	    }
+	    for(long k=p*p; k<=y; k += p*p) leaf[k] = 0;
+	}
+	leaf[1] = INT32_MAX;
+	for(long n=1; n<=y; n++)
+	{
+	    pi[n] += pi[n-1];
+	    if(std::abs(leaf[n])<=primes[c-1]) leaf[n] = 0;
+	    below[n] = leaf[n] ? n : below[n-1];
+	}
+
+	// ordinary leaves, with phi(t, c) = (t/P)*phi(P) + phiSmall[t%P] for the
+	// primorial P of the first c primes
+	vector<int> phiSmall(COUNT_PRIMES_PRIMORIAL, 0);
+	for(long t=1; t<COUNT_PRIMES_PRIMORIAL; t++)
+	{
+	    bool coprime = true;
+	    for(long i=0; i<c; i++) coprime = coprime && t%primes[i]!=0;
+	    phiSmall[t] = phiSmall[t-1] + coprime;
+	}
+	long S1 = 0;
+	for(long n=below[y]; n>0; n=below[n-1])
+	{
+	    long t = x/n;
+	    long phi = (t/COUNT_PRIMES_PRIMORIAL)*COUNT_PRIMES_TOTIENT + phiSmall[t%COUNT_PRIMES_PRIMORIAL];
+	    S1 += leaf[n]<0 ? -phi : phi;
+	}
+
+	long S2 = countPrimes_S2(x, y, primes, pi, leaf, below);
+	return S1 + S2 + a - 1 - countPrimes_P2(x, y);
+    }
+
+    //Prime Counting Function, by the LMO method
+    long countPrimes(long max)
+    {
+	if(max<2) return 0;
+	if(max<COUNT_PRIMES_SIEVE_LIMIT) return PrimeBitmap(max+1).count();
+	// y = alpha*cbrt(x) trades the sieve of the special leaves against the
+	// leaf tables; measured best near 8 at 1e11, 16 at 1e14, 24 at 1e16
+	double alpha = std::max(1.0, 3*(std::log10((double)max)-8));
+	return countPrimes_lmo(max, alpha);
+    }
+
 	
 	
 
@@ -10,6 +10,12 @@
 
 #include<vector>
 #include<map>
+#include<cstdint>
+#include<cstddef>
+#include<iterator>
+#include<utility>
+#include<algorithm>
+#include<cmath>
 
 namespace nt
 {
@@ -62,6 +68,232 @@ namespace nt
     std::vector<int> vectorFromSieve(std::vector<bool> & sieve);
 
 
+    /**
+     * Default number of odd integers handled per segment by the segmented
+     * sieves.  One byte is used per odd integer, so the default segment
+     * occupies 32KB and fits in the L1 data cache of most hosts.  Raise it
+     * towards the L2 size if the host has a small L1 or a very large number
+     * of base primes.
+     */
+    const int DEFAULT_SEGMENT_SIZE = 32768;
+
+    /**
+     * Segmented Sieve of Eratosthenes
+     * Produces exactly the same sieve as primeSieve, but crosses off
+     * composites one cache-sized segment at a time instead of sweeping the
+     * whole range once per prime.  Each base prime (up to sqrt(max)) keeps
+     * the offset of its next odd multiple between segments.  Much faster
+     * than primeSieve once the sieve no longer fits in cache.
+     *
+     * PARAMETERS: Max range for the sieve, a reference to a vector<bool> to
+     * hold the sieve, and optionally the number of odd integers per segment.
+     * RETURN: Nothing, but the vector holds the completed sieve in its first
+     * (max) entries, exactly as for primeSieve.
+     * Note: This method changes the parameter vector!  A segmentSize below 1
+     * is replaced by DEFAULT_SEGMENT_SIZE.
+     */
+    void segmentedPrimeSieve(int max, std::vector<bool> & sieve, int segmentSize = DEFAULT_SEGMENT_SIZE);
+
+    /**
+     * Segmented Sieve of Eratosthenes with list of primes
+     * Same result as primes(int max), computed with the segmented sieve.  No
+     * full-size sieve is ever allocated: memory use is the output vector,
+     * one segment, and the base primes up to sqrt(max).
+     */
+    std::vector<int> segmentedPrimes(int max, int segmentSize = DEFAULT_SEGMENT_SIZE);
+
+
+    /**
+     * Prime Bitmap
+     * A sieve of Eratosthenes that only stores the integers coprime to 30.
+     * Each block of 30 consecutive integers takes a single byte (one bit for
+     * each of the residues 1, 7, 11, 13, 17, 19, 23, 29), so the bitmap uses
+     * 1/30 of a byte per integer: about 4x less than a vector<bool> sieve,
+     * and a table up to 10^10 fits in 334MB.  The blocks are packed eight to
+     * a 64-bit word, which allows word-at-a-time iteration and popcount-based
+     * counting.  The bitmap is filled with a segmented wheel sieve.
+     *
+     * CONSTRUCTOR PARAMETERS: the max range for the sieve (a long), and
+     * optionally the number of bytes sieved per segment and the number of
+     * threads to sieve with (0 or less means one per hardware thread).
+     * Notes: All queries are about the integers in [0, max).  isPrime returns
+     * false outside of that range.  Segments are independent, so with
+     * several threads each one takes segments from a shared work pool.
+     */
+    class PrimeBitmap
+    {
+    public:
+	PrimeBitmap();
+	explicit PrimeBitmap(long max, int segmentSize = DEFAULT_SEGMENT_SIZE, int threads = 1);
+
+	// the max range of the sieve
+	long size() const { return max; }
+
+	// whether n is prime, for 0 <= n < max
+	bool isPrime(long n) const;
+
+	// the number of primes less than max
+	long count() const;
+
+	// call visit(p) for every prime p < max, in increasing order
+	template<class Visit>
+	void forEachPrime(Visit visit) const
+	{
+	    static const int residues[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+	    if(max>2) visit(2L);
+	    if(max>3) visit(3L);
+	    if(max>5) visit(5L);
+	    for(std::size_t w=0; w<bits.size(); w++)
+	    {
+		for(uint64_t word = bits[w]; word; word &= word-1)
+		{
+		    int b = __builtin_ctzll(word);
+		    visit(30*(8*(long)w+b/8) + residues[b%8]);
+		}
+	    }
+	}
+
+	// the raw bitmap: bit 8b+j of word w stands for 30*(8w+b) plus the jth
+	// residue coprime to 30
+	const std::vector<uint64_t> & words() const { return bits; }
+
+    private:
+	long max;
+	std::vector<uint64_t> bits;
+    };
+
+    /**
+     * Sieve of Eratosthenes with list of primes, bitmap version
+     * As primes(max, sieve) above, but the sieve is stored as a PrimeBitmap.
+     * Note: This method replaces the contents of the parameter bitmap!
+     */
+    std::vector<int> primes(int max, PrimeBitmap & sieve);
+
+    /**
+     * Vector From Sieve, bitmap version
+     * RETURN: a vector containing (in order) all primes in the bitmap
+     * Note: the bitmap must not extend past the range of an int.
+     */
+    std::vector<int> vectorFromSieve(const PrimeBitmap & sieve);
+
+
+    /**
+     * Parallel Sieve of Eratosthenes with list of primes
+     * Same result as primes(int max), computed on several threads.  The base
+     * primes up to sqrt(max) are found once, then the range is cut into
+     * chunks of segments that are handed out to a pool of threads; a thread
+     * that runs out of chunks steals half of the remaining chunks of another
+     * thread.  Every thread sieves with its own scratch buffers, and the
+     * primes found in each chunk are concatenated in order at the end.
+     *
+     * PARAMETERS: Max range for the sieve, the number of threads (0 or less
+     * means one per hardware thread), and optionally the segment size.
+     * RETURN: a vector<int> containing all primes less than (max) in order
+     * Note: programs using the parallel sieves must be built with -pthread.
+     */
+    std::vector<int> parallelPrimes(int max, int threads, int segmentSize = DEFAULT_SEGMENT_SIZE);
+
+
+    /**
+     * Largest upper bound accepted by the range sieves: (2^31-1)^2, a little
+     * over 4.6*10^18, so that all base primes fit in an int.
+     */
+    const uint64_t RANGE_SIEVE_MAX = 4611686014132420609ULL;
+
+    /**
+     * Range Sieve
+     * Sieve of Eratosthenes on the window [lo, hi) only.  The base primes up
+     * to sqrt(hi) are computed with segmentedPrimes, then the window is
+     * sieved (segment by segment for the small base primes), so nothing below
+     * lo is ever sieved.  This is the fast way to find primes in a narrow
+     * window far from zero, for example [10^18, 10^18 + 10^8).
+     *
+     * PARAMETERS: the bounds lo and hi of the window, a reference to a
+     * vector<bool> to hold the sieve, and optionally the segment size.
+     * RETURN: Nothing, but the vector will hold the completed sieve in its
+     * first (hi-lo) entries: position k holds "true" if and only if lo+k is
+     * prime.  Entries in the vector past (hi-lo) will not be changed.
+     * Notes: This method changes the parameter vector!  Nothing is done if
+     * hi <= lo or hi > RANGE_SIEVE_MAX.  Memory use is the sieve plus the base
+     * primes, proportional to (hi-lo) + sqrt(hi).
+     */
+    void rangeSieve(uint64_t lo, uint64_t hi, std::vector<bool> & sieve, int segmentSize = DEFAULT_SEGMENT_SIZE);
+
+    /**
+     * Range Sieve with list of primes
+     * As above, but returns the primes in [lo, hi) in order instead of a
+     * sieve.  An empty vector is returned if hi <= lo or hi > RANGE_SIEVE_MAX.
+     */
+    std::vector<uint64_t> primesInRange(uint64_t lo, uint64_t hi, int segmentSize = DEFAULT_SEGMENT_SIZE);
+
+
+    /**
+     * Prime Generator
+     * Produces the primes one at a time and in increasing order from an
+     * incremental segmented sieve, so a walk over the primes that stops early
+     * never pays for the primes it did not use.  There is no upper limit
+     * fixed in advance: the base primes are extended as the sieve moves on,
+     * and memory use is the base primes up to about sqrt(n) plus one
+     * segment, where n is the current position.
+     *
+     * CONSTRUCTOR PARAMETERS: the first number to consider (default 0), and
+     * optionally the segment size.
+     * Usage: call next() repeatedly, or iterate with a range-for loop:
+     *     for(uint64_t p : nt::PrimeGenerator()) { if(p > bound) break; ... }
+     * Notes: the generator stops (next() returns 0 and iteration ends) at
+     * RANGE_SIEVE_MAX.  Iterators share the generator's state, so only one
+     * pass can be made over a generator.
+     */
+    class PrimeGenerator
+    {
+    public:
+	explicit PrimeGenerator(uint64_t start = 0, int segmentSize = DEFAULT_SEGMENT_SIZE);
+
+	// the next prime, or 0 if there are no more
+	uint64_t next();
+
+	class iterator
+	{
+	public:
+	    typedef std::input_iterator_tag iterator_category;
+	    typedef uint64_t value_type;
+	    typedef std::ptrdiff_t difference_type;
+	    typedef const uint64_t * pointer;
+	    typedef const uint64_t & reference;
+
+	    iterator() : generator(0), value(0) {}
+	    explicit iterator(PrimeGenerator * generator) : generator(generator), value(generator->next()) {}
+
+	    reference operator*() const { return value; }
+	    pointer operator->() const { return &value; }
+	    iterator & operator++() { value = generator->next(); return *this; }
+	    iterator operator++(int) { iterator old = *this; ++*this; return old; }
+	    // the end iterator holds 0, which is also what an exhausted
+	    // generator produces
+	    bool operator==(const iterator & other) const { return value == other.value; }
+	    bool operator!=(const iterator & other) const { return value != other.value; }
+
+	private:
+	    PrimeGenerator * generator;
+	    uint64_t value;
+	};
+
+	iterator begin() { return iterator(this); }
+	iterator end() { return iterator(); }
+
+    private:
+	bool nextSegment();
+
+	bool pendingTwo;
+	std::vector<char> segment;
+	uint64_t first; // index of the odd number 2*first+1 held in segment[0]
+	int length, position;
+	std::vector<int> basePrimes;
+	std::vector<uint64_t> nextMultiple;
+	uint64_t baseLimit; // basePrimes holds the odd primes p with p*p < baseLimit
+    };
+
+
     /**
      * Smallest Prime Factor Sieve
      * Sieve of Eratosthenes that also produces the smallest prime factor of
@@ -108,6 +340,66 @@ namespace nt
     void smallestPrimePowers(int max, std::vector<bool> & sieve, std::vector<int> & smallPrimeFactors, std::vector<int> & smallPrimePowers, std::vector<int> & exponents);
 
 
+    /**
+     * Prime Factorization
+     * A list of (prime, exponent) pairs, in increasing order of the primes,
+     * with a fixed capacity so that it never touches the heap.  15 pairs are
+     * enough for any 64-bit integer.  Iterate over it like a container:
+     *     for(const auto & pk : factorization) { pk.first, pk.second ... }
+     */
+    struct Factorization
+    {
+	static const int MAX_FACTORS = 15;
+
+	int length;
+	std::pair<uint64_t, int> factors[MAX_FACTORS];
+
+	Factorization() : length(0) {}
+	int size() const { return length; }
+	const std::pair<uint64_t, int> & operator[](int i) const { return factors[i]; }
+	const std::pair<uint64_t, int> * begin() const { return factors; }
+	const std::pair<uint64_t, int> * end() const { return factors+length; }
+	void add(uint64_t p, int k) { factors[length++] = std::make_pair(p, k); }
+    };
+
+    /**
+     * Compact Smallest Prime Factor Table
+     * Holds the same information as smallestPrimeFactors, in a quarter of the
+     * memory: only odd n are stored (the factors of 2 are found with a bit
+     * scan), and each entry is a 16-bit index into the list of primes up to
+     * sqrt(max) instead of the prime itself.  A prime n has entry 0, so
+     * primes above sqrt(max) never need to be stored anywhere.  That is 1 byte
+     * per integer, against about 4.1 for the vectors of smallestPrimeFactors.
+     *
+     * CONSTRUCTOR PARAMETERS: the max range (max) for the table.
+     * Notes: All queries take 0 <= n < max.  By convention the smallest prime
+     * factor of 0 is 0 and of 1 is 1, and both have an empty factorization.
+     */
+    class SmallestFactorTable
+    {
+    public:
+	SmallestFactorTable();
+	explicit SmallestFactorTable(int max);
+
+	// the max range of the table
+	int size() const { return max; }
+
+	// the smallest prime factor of n
+	int smallestPrimeFactor(int n) const;
+
+	// the prime factorization of n, without any heap allocation
+	Factorization factorize(int n) const;
+
+	// factorizations[i] receives the factorization of numbers[i]
+	void factorize(const std::vector<int> & numbers, std::vector<Factorization> & factorizations) const;
+
+    private:
+	int max;
+	std::vector<int> primes; // odd primes up to sqrt(max)
+	std::vector<uint16_t> entries; // entries[n/2] for odd n
+    };
+
+
 
     /**
      * Euler's Totient Function Sieve
@@ -130,6 +422,272 @@ namespace nt
     void eulerTotientSieve(int max, std::vector<bool> & sieve, std::vector<int> & totients);
 
 
+    /**
+     * Multiplicative Function Policies
+     * A multiplicative function f is described by its values on prime
+     * powers.  A policy class provides
+     *     typedef ... value_type;
+     *     value_type primePower(long p, int k, long pk) const;
+     * where primePower returns f(p^k) and pk = p^k.  value_type must support
+     * operator* and be constructible from the integers 0 and 1.  The policies
+     * below cover the usual functions; user-defined policies work the same
+     * way (a modular value_type gives the table mod m).
+     */
+
+    // Euler's totient function phi
+    struct TotientFunction
+    {
+	typedef long value_type;
+	value_type primePower(long p, int /*k*/, long pk) const { return pk-pk/p; }
+    };
+
+    // the Mobius function mu
+    struct MobiusFunction
+    {
+	typedef int value_type;
+	value_type primePower(long /*p*/, int k, long /*pk*/) const { return k==1 ? -1 : 0; }
+    };
+
+    // the number of divisors d(n)
+    struct DivisorCountFunction
+    {
+	typedef long value_type;
+	value_type primePower(long /*p*/, int k, long /*pk*/) const { return k+1; }
+    };
+
+    // the sum of the (power)th powers of the divisors, sigma_power(n)
+    struct DivisorSumFunction
+    {
+	typedef long value_type;
+	int power;
+	explicit DivisorSumFunction(int power = 1) : power(power) {}
+	value_type primePower(long p, int k, long /*pk*/) const
+	{
+	    long q = 1, sum = 1, term = 1;
+	    for(int i=0; i<power; i++) q *= p;
+	    for(int i=0; i<k; i++) sum += (term *= q);
+	    return sum;
+	}
+    };
+
+    /**
+     * Multiplicative Function Table
+     * Pairs a policy with the vector that receives its values, for use with
+     * linearSieve below.  Build one with tableOf, e.g.
+     *     nt::tableOf<nt::TotientFunction>(phi)
+     *     nt::tableOf(sigma2, nt::DivisorSumFunction(2))
+     */
+    template<class Policy>
+    struct MultiplicativeTable
+    {
+	Policy f;
+	std::vector<typename Policy::value_type> & values;
+	MultiplicativeTable(std::vector<typename Policy::value_type> & values, const Policy & f) : f(f), values(values) {}
+    };
+
+    template<class Policy>
+    MultiplicativeTable<Policy> tableOf(std::vector<typename Policy::value_type> & values, const Policy & f = Policy())
+    {
+	return MultiplicativeTable<Policy>(values, f);
+    }
+
+    // helpers for linearSieve
+    template<class Policy>
+    int linearSieve_init(MultiplicativeTable<Policy> & table, int max)
+    {
+	typedef typename Policy::value_type value_type;
+	if(max>table.values.size()) table.values.resize(max);
+	table.values[0] = value_type(0);
+	if(max>1) table.values[1] = value_type(1);
+	return 0;
+    }
+
+    template<class Policy>
+    int linearSieve_set(MultiplicativeTable<Policy> & table, int n, int p, int k, int pk)
+    {
+	if(pk==n) table.values[n] = table.f.primePower(p, k, pk);
+	else table.values[n] = table.values[n/pk] * table.values[pk];
+	return 0;
+    }
+
+    /**
+     * Linear Sieve for Multiplicative Functions
+     * Euler's linear sieve: every composite n < max is reached exactly once,
+     * as (n/p)*p with p its smallest prime factor, so the sieve runs in O(max)
+     * time.  Along the way it tracks the largest power p^k of the smallest
+     * prime dividing n, and sets f(n) = f(n/p^k) * f(p^k) for every table it
+     * is given.  Several functions can be tabulated in a single pass over the
+     * integers by passing several tables.
+     *
+     * PARAMETERS: the max range (max) for the sieve, a vector (primes) to hold
+     * the primes found, and any number of MultiplicativeTables (see tableOf).
+     * RETURN: Nothing, but primes holds the primes less than max in order and
+     * each table's vector holds f(n) in its first (max) entries.
+     * Notes: This function changes the vector parameters!  By convention
+     * f(0) = 0 and f(1) = 1.  Besides the tables, the sieve uses about 9 bytes
+     * per integer of scratch memory.
+     * Example:
+     *     std::vector<long> phi; std::vector<int> mu, primes;
+     *     nt::linearSieve(max, primes, nt::tableOf<nt::TotientFunction>(phi),
+     *                     nt::tableOf<nt::MobiusFunction>(mu));
+     */
+    template<class... Policies>
+    void linearSieve(int max, std::vector<int> & primes, MultiplicativeTable<Policies>... tables)
+    {
+	primes.clear();
+	if(max<=0) return;
+	int init[] = {0, linearSieve_init(tables, max)...};
+	(void)init;
+
+	// smallest prime factor, the power of it dividing n, and its exponent
+	std::vector<int> smallPrimeFactors(max, 0), smallPrimePowers(max, 0);
+	std::vector<unsigned char> exponents(max, 0);
+
+	for(int n=2; n<max; n++)
+	{
+	    if(smallPrimeFactors[n]==0)
+	    {
+		smallPrimeFactors[n] = smallPrimePowers[n] = n;
+		exponents[n] = 1;
+		primes.push_back(n);
+	    }
+	    int p = smallPrimeFactors[n];
+	    int set[] = {0, linearSieve_set(tables, n, p, exponents[n], smallPrimePowers[n])...};
+	    (void)set;
+
+	    for(std::size_t i=0; i<primes.size(); i++)
+	    {
+		int q = primes[i];
+		if(q>p || (long)n*q>=max) break;
+		int m = n*q;
+		smallPrimeFactors[m] = q;
+		if(q==p)
+		{
+		    smallPrimePowers[m] = smallPrimePowers[n]*q;
+		    exponents[m] = exponents[n]+1;
+		}
+		else
+		{
+		    smallPrimePowers[m] = q;
+		    exponents[m] = 1;
+		}
+	    }
+	}
+	return;
+    }
+
+
+    /**
+     * Window Sieve
+     * Finds the factorizations of all the integers in a window [lo, hi) far
+     * from 0.  Each n starts as its own cofactor; for every prime p up to
+     * sqrt(hi), the power of p is divided out of the cofactors of its
+     * multiples in the window, and whatever is left above 1 at the end is a
+     * single prime above sqrt(hi).
+     *
+     * PARAMETERS: the window [lo, hi) (longs, with 0 <= lo and hi up to about
+     * 10^18), and a function (visit) to be called as visit(i, p, k, pk) for
+     * every prime power p^k = pk exactly dividing n = lo+i.
+     * RETURN: Nothing
+     * Notes: The primes of each n are visited in increasing order.  0 and 1
+     * have no prime factors.  Memory is 8 bytes per integer of the window,
+     * plus a PrimeBitmap of the primes up to sqrt(hi): 33MB for hi = 10^18.
+     */
+    template<class Visit>
+    void windowSieve(long lo, long hi, Visit visit)
+    {
+	lo = std::max(lo, 0L);
+	if(hi<=lo) return;
+	std::vector<long> cofactors(hi-lo);
+	for(long i=0; i<hi-lo; i++) cofactors[i] = lo+i;
+
+	long root = (long)std::sqrt((double)(hi-1));
+	while(root*root > hi-1) root--;
+	while((root+1)*(root+1) <= hi-1) root++;
+	PrimeBitmap(root+1).forEachPrime([&](long p)
+	{
+	    // 0 is divisible by everything, so start past it
+	    long first = lo%p==0 ? std::max(lo, p) : lo+p-lo%p;
+	    for(long m=first; m<hi; m += p)
+	    {
+		long c = cofactors[m-lo]/p, pk = p;
+		int k = 1;
+		while(c%p==0)
+		{
+		    c /= p;
+		    pk *= p;
+		    k++;
+		}
+		cofactors[m-lo] = c;
+		visit(m-lo, p, k, pk);
+	    }
+	});
+	for(long i=0; i<hi-lo; i++)
+	{
+	    if(cofactors[i]>1) visit(i, cofactors[i], 1, cofactors[i]);
+	}
+    }
+
+    // helpers for multiplicativeWindow
+    template<class Policy>
+    int multiplicativeWindow_init(MultiplicativeTable<Policy> & table, long lo, long hi)
+    {
+	typedef typename Policy::value_type value_type;
+	table.values.assign(hi-lo, value_type(1));
+	if(lo==0) table.values[0] = value_type(0);
+	return 0;
+    }
+
+    template<class Policy>
+    int multiplicativeWindow_set(MultiplicativeTable<Policy> & table, long i, long p, int k, long pk)
+    {
+	table.values[i] = table.values[i] * table.f.primePower(p, k, pk);
+	return 0;
+    }
+
+    /**
+     * Windowed Multiplicative Function Sieve
+     * Tabulates multiplicative functions on a window [lo, hi) with
+     * windowSieve, for windows that do not start near 0.
+     *
+     * PARAMETERS: the window [lo, hi) (longs, with 0 <= lo and hi up to about
+     * 10^18), and any number of MultiplicativeTables (see tableOf).
+     * RETURN: Nothing, but each table's vector holds f(lo+i) at index i.
+     * Notes: This function changes the vector parameters!  By convention
+     * f(0) = 0 and f(1) = 1.  value_type must not overflow on the window:
+     * TotientFunction, MobiusFunction and DivisorCountFunction never do.
+     * Example:
+     *     std::vector<long> phi; std::vector<int> mu;
+     *     nt::multiplicativeWindow(lo, hi, nt::tableOf<nt::TotientFunction>(phi),
+     *                              nt::tableOf<nt::MobiusFunction>(mu));
+     */
+    template<class... Policies>
+    void multiplicativeWindow(long lo, long hi, MultiplicativeTable<Policies>... tables)
+    {
+	lo = std::max(lo, 0L);
+	if(hi<=lo) return;
+	int init[] = {0, multiplicativeWindow_init(tables, lo, hi)...};
+	(void)init;
+	windowSieve(lo, hi, [&](long i, long p, int k, long pk)
+	{
+	    int set[] = {0, multiplicativeWindow_set(tables, i, p, k, pk)...};
+	    (void)set;
+	});
+    }
+
+    /**
+     * Windowed Prime Factorization
+     * PARAMETERS: the window [lo, hi) (longs, with 0 <= lo and hi up to about
+     * 10^18), and a vector (factorizations) to hold the results.
+     * RETURN: Nothing, but factorizations[i] holds the factorization of lo+i.
+     * Notes: This function changes the vector parameter!  Much faster than
+     * factoring each number on its own when the window is wider than a few
+     * thousand.  A Factorization takes 244 bytes, so for wide windows
+     * windowSieve with a custom visitor uses far less memory.
+     */
+    void factorizeWindow(long lo, long hi, std::vector<Factorization> & factorizations);
+
+
     /**
      * Prime Counting Function
      * 
@@ -142,6 +700,20 @@ namespace nt
 
     long countPrimes(long max, std::vector<int> & primes);
 
+    /**
+     * Prime Counting Function, by the Lagarias-Miller-Odlyzko method
+     * 
+     * PARAMETERS: (max), the number to count all primes up to
+     * RETURN: the number of primes up to (and including) max.
+     * Notes: Runs in about O(max^(2/3)) time, and memory for the primes up to
+     * sqrt(max) plus O(max^(1/3)) arrays.  It uses flat arrays and a
+     * segmented sieve instead of a memo, so it needs no primes from the
+     * caller.  Below 2^24 it just counts a PrimeBitmap.
+     * Takes about 1.5 seconds for 1e14 and 20 seconds for 1e16.
+     */
+
+    long countPrimes(long max);
+
 
     /**
      * Memoized Prime Counting Function
@@ -158,6 +730,66 @@ namespace nt
 
     long countPrimesMemoized(long max, std::vector<int> & primes, std::map<long, long> & memo);
 
+
+    /**
+     * Prime Count Memo
+     * A memo for countPrimesMemoized sized for the values it actually needs:
+     * the recursion for pi(N) only asks for pi(v) with v <= sqrt(N) or v of
+     * the form N/k (rounded down), which are fewer than 2*sqrt(N) values.
+     * They are stored in two flat arrays, the first indexed by v and the
+     * second by N/v, so a lookup is an array access instead of a map search.
+     *
+     * CONSTRUCTOR PARAMETERS: the largest value N that will be queried (a
+     * long).
+     * Notes: find returns -1 for values that have not been stored.  Values
+     * above N or of any other form are not stored, but they are still safe
+     * to pass: they just miss.  Takes 16*sqrt(N) bytes.
+     */
+
+    class PrimeCountMemo
+    {
+    public:
+	explicit PrimeCountMemo(long n);
+
+	// the largest value that can be stored
+	long limit() const { return n; }
+
+	// the stored pi(v), or -1
+	long find(long v) const
+	{
+	    if(v<=sqrtN) return v<0 ? -1 : small[v];
+	    if(v>n || n/(n/v)!=v) return -1;
+	    return large[n/v];
+	}
+
+	// store pi(v) = count, if v has a slot
+	void store(long v, long count)
+	{
+	    if(v<0) return;
+	    if(v<=sqrtN) small[v] = count;
+	    else if(v<=n && n/(n/v)==v) large[n/v] = count;
+	}
+
+    private:
+	long n, sqrtN;
+	std::vector<long> small, large;
+    };
+
+    /**
+     * Memoized Prime Counting Function, with a flat memo
+     * PARAMETERS: (max), the number to count all primes up to, (primes), a
+     * vector of ints containing all primes up to sqrt(max) in order, and
+     * (memo), a PrimeCountMemo.
+     * RETURN: the number of primes up to (and including) max.  memo is updated
+     * with the values of the function used in computation that it has room for.
+     * Notes: Same as the map version, but much faster for repeated queries.
+     * Build the memo with the largest max that will be asked for: the values
+     * used for pi(N) are N/k, and are only shared between calls with the same
+     * N or with N of the form memo.limit()/k.
+     */
+
+    long countPrimesMemoized(long max, std::vector<int> & primes, PrimeCountMemo & memo);
+
 }
 
 #endif
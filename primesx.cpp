@@ -0,0 +1,322 @@
+// implementation of high precision functions about primes in primesx.hpp
+
+#include<algorithm>
+#include "numthy/primesx.hpp"
+#include "numthy/modarithx.hpp"
+#include "numthy/modarith.hpp"
+
+using std::vector;
+
+namespace nt
+{
+    static const int isPrime_smallPrimes[18] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61};
+    static const uint64_t isPrime_bases[7] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+    static const uint64_t isPrime_smallBases[3] = {2, 7, 61};
+
+    // trial division; returns 1 for prime, 0 for composite, -1 if undecided
+    int isPrime_screen(uint64_t n)
+    {
+	if(n<2) return 0;
+	for(int i=0; i<18; i++)
+	{
+	    if(n==(uint64_t)isPrime_smallPrimes[i]) return 1;
+	    if(n%isPrime_smallPrimes[i]==0) return 0;
+	}
+	return n < 67*67 ? 1 : -1;
+    }
+
+    // Miller-Rabin strong probable prime test of odd n to Montgomery base x
+    // already raised to the odd part d of n-1; n-1 = d*2^s
+    bool isPrime_strongTest(const Modulus64 & mont, uint64_t x, int s)
+    {
+	uint64_t minusOne = mont.value()-mont.montgomeryOne();
+	if(x==mont.montgomeryOne() || x==minusOne) return true;
+	for(int i=1; i<s; i++)
+	{
+	    x = mont.montgomeryMul(x, x);
+	    if(x==minusOne) return true;
+	}
+	return false;
+    }
+
+    // Primality Test
+    bool isPrime(uint64_t n)
+    {
+	int screen = isPrime_screen(n);
+	if(screen>=0) return screen;
+
+	Modulus64 mont(n);
+	uint64_t d = n-1;
+	int s = __builtin_ctzll(d);
+	d >>= s;
+
+	const uint64_t * bases = isPrime_bases;
+	int baseCount = 7;
+	if(n < 4759123141ULL)
+	{
+	    bases = isPrime_smallBases;
+	    baseCount = 3;
+	}
+	for(int i=0; i<baseCount; i++)
+	{
+	    uint64_t a = bases[i]%n;
+	    if(a==0) continue;
+	    if(!isPrime_strongTest(mont, mont.montgomeryPow(mont.toMontgomery(a), d), s)) return false;
+	}
+	return true;
+    }
+
+    // Batch Primality Test
+    void isPrime(const vector<uint64_t> & candidates, vector<bool> & results)
+    {
+	const int LANES = 4;
+	results.assign(candidates.size(), false);
+
+	vector<size_t> pending;
+	vector<Modulus64> monts;
+	for(size_t i=0; i<candidates.size(); i++)
+	{
+	    int screen = isPrime_screen(candidates[i]);
+	    if(screen>=0) results[i] = screen;
+	    else
+	    {
+		pending.push_back(i);
+		monts.push_back(Modulus64(candidates[i]));
+	    }
+	}
+
+	/* One round per base.  Most composites fail the first round, so the
+	 * later rounds only see the (mostly prime) survivors.
+	 */
+	for(int round=0; round<7 && !pending.empty(); round++)
+	{
+	    size_t survivors = 0;
+	    for(size_t start=0; start<pending.size(); start += LANES)
+	    {
+		// a short last group repeats its final candidate
+		size_t lane[LANES];
+		uint64_t d[LANES], x[LANES], base[LANES];
+		int s[LANES];
+		uint64_t maxD = 0;
+		for(int l=0; l<LANES; l++)
+		{
+		    lane[l] = std::min(start+l, pending.size()-1);
+		    uint64_t n = monts[lane[l]].value();
+		    s[l] = __builtin_ctzll(n-1);
+		    d[l] = (n-1) >> s[l];
+		    maxD = std::max(maxD, d[l]);
+		    base[l] = monts[lane[l]].toMontgomery(isPrime_bases[round]);
+		    x[l] = monts[lane[l]].montgomeryOne();
+		}
+
+		// left-to-right exponentiation, all lanes in step; the lanes are
+		// independent, so their multiplications overlap in the pipeline,
+		// and the multiply is selected rather than branched on
+		const Modulus64 m0 = monts[lane[0]], m1 = monts[lane[1]], m2 = monts[lane[2]], m3 = monts[lane[3]];
+		for(int bit=63-__builtin_clzll(maxD); bit>=0; bit--)
+		{
+		    x[0] = m0.montgomeryMul(x[0], x[0]);
+		    x[1] = m1.montgomeryMul(x[1], x[1]);
+		    x[2] = m2.montgomeryMul(x[2], x[2]);
+		    x[3] = m3.montgomeryMul(x[3], x[3]);
+		    uint64_t y0 = m0.montgomeryMul(x[0], base[0]), y1 = m1.montgomeryMul(x[1], base[1]);
+		    uint64_t y2 = m2.montgomeryMul(x[2], base[2]), y3 = m3.montgomeryMul(x[3], base[3]);
+		    x[0] = (d[0]>>bit)&1 ? y0 : x[0];
+		    x[1] = (d[1]>>bit)&1 ? y1 : x[1];
+		    x[2] = (d[2]>>bit)&1 ? y2 : x[2];
+		    x[3] = (d[3]>>bit)&1 ? y3 : x[3];
+		}
+
+		for(int l=0; l<LANES && start+l<pending.size(); l++)
+		{
+		    // a base divisible by n says nothing
+		    if(base[l]==0 || isPrime_strongTest(monts[lane[l]], x[l], s[l]))
+		    {
+			pending[survivors] = pending[lane[l]];
+			monts[survivors] = monts[lane[l]];
+			survivors++;
+		    }
+		}
+	    }
+	    pending.resize(survivors);
+	    monts.resize(survivors, Modulus64(3));
+	}
+
+	for(size_t i=0; i<pending.size(); i++) results[pending[i]] = true;
+    }
+
+
+    // a nontrivial factor of the odd composite n, by Brent's variant of
+    // Pollard's rho with x -> x^2+c
+    uint64_t factorize_rho(uint64_t n)
+    {
+	const uint64_t BATCH = 128;
+	Modulus64 mont(n);
+
+	for(uint64_t c = 1; ; c++)
+	{
+	    uint64_t add = mont.toMontgomery(c);
+	    auto f = [&](uint64_t x)
+	    {
+		uint64_t y = mont.montgomeryMul(x, x)+add;
+		return y>=n || y<add ? y-n : y;
+	    };
+
+	    uint64_t x = mont.montgomeryOne(), y = mont.montgomeryOne(), ys = y, q = mont.montgomeryOne(), g = 1;
+	    for(uint64_t r = 1; g==1; r *= 2)
+	    {
+		x = y;
+		for(uint64_t i=0; i<r; i++) y = f(y);
+		// multiply the differences together and take one gcd per batch
+		for(uint64_t k=0; k<r && g==1; k += BATCH)
+		{
+		    ys = y;
+		    for(uint64_t i=0; i<BATCH && i<r-k; i++)
+		    {
+			y = f(y);
+			q = mont.montgomeryMul(q, x>y ? x-y : y-x);
+		    }
+		    g = binaryGcd(q, n);
+		}
+	    }
+	    if(g==n)
+	    {
+		// the batch overshot: redo it one step at a time
+		do
+		{
+		    ys = f(ys);
+		    g = binaryGcd(x>ys ? x-ys : ys-x, n);
+		} while(g==1);
+	    }
+	    if(g!=n) return g;
+	}
+    }
+
+    // Prime Factorization
+    Factorization factorize(uint64_t n)
+    {
+	static const vector<int> smallPrimes = primes(1024);
+	Factorization result;
+	if(n<2) return result;
+
+	for(size_t i=0; i<smallPrimes.size(); i++)
+	{
+	    uint64_t p = smallPrimes[i];
+	    if(p*p>n) break;
+	    if(n%p==0)
+	    {
+		int k = 0;
+		do
+		{
+		    n /= p;
+		    k++;
+		} while(n%p==0);
+		result.add(p, k);
+	    }
+	}
+	if(n==1) return result;
+
+	// split the cofactor until only primes are left
+	uint64_t found[64], pending[64];
+	int foundCount = 0, pendingCount = 0;
+	pending[pendingCount++] = n;
+	while(pendingCount>0)
+	{
+	    uint64_t m = pending[--pendingCount];
+	    if(m < 1024*1024 || isPrime(m)) found[foundCount++] = m;
+	    else
+	    {
+		uint64_t d = factorize_rho(m);
+		pending[pendingCount++] = d;
+		pending[pendingCount++] = m/d;
+	    }
+	}
+
+	std::sort(found, found+foundCount);
+	for(int i=0; i<foundCount; )
+	{
+	    int j = i;
+	    while(j<foundCount && found[j]==found[i]) j++;
+	    result.add(found[i], j-i);
+	    i = j;
+	}
+	return result;
+    }
+
+    std::pair<long, long> countPrimesMod4(long n)
+    {
+	if(n<3) return std::pair<long, long>(0, 0);
+	long count = (long)PrimeSum<PrimeCountWeight>(n)(n);
+	long character = (long)(__int128)PrimeSum<Mod4CharacterWeight>(n)(n);
+	return std::pair<long, long>((count-1+character)/2, (count-1-character)/2);
+    }
+
+    // linear sieves that leave f(n) in prefix[n], then sum in place; the
+    // primes vector is the only other memory
+    void summatory_sieve(const TotientFunction & /*f*/, long max, vector<long> & prefix)
+    {
+	prefix.assign(max+1, 0);
+	if(max>=1) prefix[1] = 1;
+	vector<long> primes;
+	for(long i=2; i<=max; i++)
+	{
+	    if(prefix[i]==0)
+	    {
+		prefix[i] = i-1;
+		primes.push_back(i);
+	    }
+	    for(std::size_t j=0; j<primes.size(); j++)
+	    {
+		long p = primes[j];
+		if(i*p>max) break;
+		if(i%p==0)
+		{
+		    prefix[i*p] = prefix[i]*p;
+		    break;
+		}
+		prefix[i*p] = prefix[i]*(p-1);
+	    }
+	}
+	for(long i=1; i<=max; i++) prefix[i] += prefix[i-1];
+    }
+
+    void summatory_sieve(const MobiusFunction & /*f*/, long max, vector<long> & prefix)
+    {
+	// 2 marks the integers not reached yet
+	prefix.assign(max+1, 2);
+	prefix[0] = 0;
+	if(max>=1) prefix[1] = 1;
+	vector<long> primes;
+	for(long i=2; i<=max; i++)
+	{
+	    if(prefix[i]==2)
+	    {
+		prefix[i] = -1;
+		primes.push_back(i);
+	    }
+	    for(std::size_t j=0; j<primes.size(); j++)
+	    {
+		long p = primes[j];
+		if(i*p>max) break;
+		if(i%p==0)
+		{
+		    prefix[i*p] = 0;
+		    break;
+		}
+		prefix[i*p] = -prefix[i];
+	    }
+	}
+	for(long i=1; i<=max; i++) prefix[i] += prefix[i-1];
+    }
+
+    unsigned __int128 sumTotients(long n)
+    {
+	return SummatoryFunction<TotientFunction>(n)(n);
+    }
+
+    long mertens(long n)
+    {
+	return (long)(__int128)SummatoryFunction<MobiusFunction>(n)(n);
+    }
+
+}
@@ -0,0 +1,383 @@
+/*
+ * This file contains higher precision versions of the functions in primes.hpp
+ * These are functions whose inputs and outputs are 64-bit integers, but
+ * where using solely 64-bit integers in intermediary calculations could
+ * result in overflow.
+ */
+
+#ifndef BR_PRIMES_X_HPP
+#define BR_PRIMES_X_HPP
+
+#include<vector>
+#include<cstdint>
+#include<cmath>
+#include<algorithm>
+#include<utility>
+#include "numthy/primes.hpp"
+#include "numthy/modarithx.hpp"
+
+namespace nt
+{
+    /**
+     * Primality Test
+     * Deterministic Miller-Rabin test for 64-bit integers.
+     * PARAMETERS: the number n to test (unsigned 64-bit)
+     * RETURN: true if n is prime, false otherwise
+     * Notes: n is first screened by trial division by the primes below 64.
+     * Survivors get a strong probable prime test to each of the bases
+     * 2, 325, 9375, 28178, 450775, 9780504 and 1795265022, a set with no
+     * composite counterexample below 2^64 (bases 2, 7 and 61 suffice below
+     * 4759123141).  The exponentiations use Montgomery multiplication in
+     * 128-bit arithmetic, so no division is done after the screening.
+     */
+    bool isPrime(uint64_t n);
+
+    /**
+     * Batch Primality Test
+     * PARAMETERS: a vector (candidates) of numbers to test, and a vector
+     * (results) to hold the answers.
+     * RETURN: Nothing, but results[i] is set to isPrime(candidates[i]).
+     * Notes: This function changes the vector parameter!  Candidates that
+     * survive the screening are tested four at a time, with the four modular
+     * exponentiations interleaved step by step to hide the latency of the
+     * multiplications.  Much faster than calling isPrime in a loop when most
+     * candidates get that far.
+     */
+    void isPrime(const std::vector<uint64_t> & candidates, std::vector<bool> & results);
+
+    /**
+     * Prime Factorization
+     * PARAMETERS: the number n to factor (unsigned 64-bit)
+     * RETURN: the prime factorization of n as (prime, exponent) pairs in
+     * increasing order of the primes, in the same form as
+     * SmallestFactorTable::factorize.  0 and 1 have empty factorizations.
+     * Notes: primes below 1024 are removed by trial division.  Whatever is
+     * left is split with Brent's variant of Pollard's rho method (working in
+     * Montgomery form, with the gcds batched over 128 steps), and each piece
+     * is checked with isPrime.  Expected time is O(n^(1/4)) multiplications
+     * in the worst case, when n is a product of two 32-bit primes.
+     */
+    Factorization factorize(uint64_t n);
+
+
+    /**
+     * Prime Sum Rings
+     * The arithmetic that PrimeSum accumulates in.  A ring provides
+     *     typedef ... value_type;
+     *     value_type from(long a) const;
+     *     value_type add(value_type a, value_type b) const;
+     *     value_type sub(value_type a, value_type b) const;
+     *     value_type mul(value_type a, value_type b) const;
+     * ExactRing works mod 2^128, so its sums are exact whenever the true
+     * sum fits in 128 bits (as __int128 for signed sums); ModularRing works
+     * mod any 64-bit modulus.
+     */
+
+    struct ExactRing
+    {
+	typedef unsigned __int128 value_type;
+	value_type from(long a) const { return (value_type)(__int128)a; }
+	value_type add(value_type a, value_type b) const { return a+b; }
+	value_type sub(value_type a, value_type b) const { return a-b; }
+	value_type mul(value_type a, value_type b) const { return a*b; }
+    };
+
+    struct ModularRing
+    {
+	typedef uint64_t value_type;
+	Modulus64 modulus;
+	explicit ModularRing(uint64_t m) : modulus(m) {}
+	value_type from(long a) const { return modulus.reduce(a); }
+	value_type add(value_type a, value_type b) const { return modulus.add(a, b); }
+	value_type sub(value_type a, value_type b) const { return modulus.sub(a, b); }
+	value_type mul(value_type a, value_type b) const { return modulus.mul(a, b); }
+    };
+
+    /**
+     * Prime Sum Weights
+     * A completely multiplicative function f to sum over the primes.  A
+     * weight provides, for any ring,
+     *     value(p, ring), which is f(p), and
+     *     prefix(v, ring), which is f(1) + f(2) + ... + f(v),
+     * where prefix must have a closed form for the method to be fast.
+     */
+
+    // f(p) = 1, to count primes
+    struct PrimeCountWeight
+    {
+	template<class Ring>
+	typename Ring::value_type value(long /*p*/, const Ring & ring) const { return ring.from(1); }
+	template<class Ring>
+	typename Ring::value_type prefix(long v, const Ring & ring) const { return ring.from(v); }
+    };
+
+    // f(p) = p^POWER, for POWER 1, 2 or 3
+    template<int POWER = 1>
+    struct PrimePowerWeight
+    {
+	static_assert(POWER>=1 && POWER<=3, "PrimePowerWeight has prefix sums for powers 1 to 3 only");
+
+	template<class Ring>
+	typename Ring::value_type value(long p, const Ring & ring) const
+	{
+	    typename Ring::value_type x = ring.from(p), y = x;
+	    for(int i=1; i<POWER; i++) y = ring.mul(y, x);
+	    return y;
+	}
+
+	// Faulhaber's formulas, dividing the factors before multiplying so
+	// that they also work in a ring without 2 or 3 invertible
+	template<class Ring>
+	typename Ring::value_type prefix(long v, const Ring & ring) const
+	{
+	    long a = v, b = v+1, c = 2*v+1;
+	    if(a%2==0) a /= 2;
+	    else b /= 2;
+	    if(POWER==1) return ring.mul(ring.from(a), ring.from(b));
+	    if(POWER==3) return ring.mul(ring.mul(ring.from(a), ring.from(b)), ring.mul(ring.from(a), ring.from(b)));
+	    if(v%3==0) a /= 3;
+	    else if(v%3==2) b /= 3;
+	    else c /= 3;
+	    return ring.mul(ring.mul(ring.from(a), ring.from(b)), ring.from(c));
+	}
+    };
+
+    // f(p) = chi(p) for the nontrivial character mod 4: 0 for 2, 1 for
+    // p = 1 mod 4 and -1 for p = 3 mod 4
+    struct Mod4CharacterWeight
+    {
+	template<class Ring>
+	typename Ring::value_type value(long p, const Ring & ring) const { return ring.from(p%2==0 ? 0 : p%4==1 ? 1 : -1); }
+	template<class Ring>
+	typename Ring::value_type prefix(long v, const Ring & ring) const { return ring.from(v%4==1 || v%4==2); }
+    };
+
+    /**
+     * Prime Sum
+     * The sum of f(p) over the primes p <= v, for a completely multiplicative
+     * weight f and every v of the form n/k (rounded down), by Lucy_Hedgehog's
+     * method: start from S(v) = f(2) + ... + f(v) and, for each prime p up
+     * to sqrt(n), remove the numbers whose smallest prime factor is p,
+     *     S(v) -= f(p) * (S(v/p) - S(p-1))     for v >= p^2.
+     * The values are kept in two flat arrays, by v for v <= sqrt(n) and by
+     * n/v above, as in PrimeCountMemo.
+     *
+     * CONSTRUCTOR PARAMETERS: the max range (n) of the sums (a long), and
+     * optionally the weight and the ring (see above).
+     * Notes: Runs in O(n^(3/4)/log(n)) time and O(sqrt(n)) memory; n = 1e12
+     * takes about a second, 1e13 about 6 seconds (exact) to 12 (modular).
+     * operator() answers for 0 <= v <= sqrt(n) or v of the form n/k, and
+     * returns 0 otherwise.
+     * Examples:
+     *     nt::PrimeSum<nt::PrimePowerWeight<>> sums(n);  // exact, p^1
+     *     unsigned __int128 total = sums(n);
+     *     nt::PrimeSum<nt::PrimePowerWeight<2>, nt::ModularRing>
+     *         squares(n, nt::PrimePowerWeight<2>(), nt::ModularRing(1000000007));
+     */
+    template<class Weight, class Ring = ExactRing>
+    class PrimeSum
+    {
+    public:
+	typedef typename Ring::value_type value_type;
+
+	explicit PrimeSum(long n, const Weight & weight = Weight(), const Ring & ring = Ring()) : n(n), ring(ring)
+	{
+	    sqrtN = isqrt(n);
+	    small.resize(sqrtN+1);
+	    large.resize(sqrtN+1);
+	    value_type one = weight.prefix(1, ring);
+	    small[0] = ring.from(0);
+	    for(long v=1; v<=sqrtN; v++) small[v] = ring.sub(weight.prefix(v, ring), one);
+	    for(long k=1; k<=sqrtN; k++) large[k] = ring.sub(weight.prefix(n/k, ring), one);
+
+	    std::vector<int> primes = segmentedPrimes((int)sqrtN+1);
+	    for(std::size_t i=0; i<primes.size(); i++)
+	    {
+		long p = primes[i], p2 = p*p;
+		value_type fp = weight.value(p, ring), base = small[p-1];
+		long kMax = std::min(sqrtN, n/p2), kSplit = std::min(kMax, sqrtN/p);
+		// n/(k*p) has a large index while k*p <= sqrt(n)
+		for(long k=1; k<=kSplit; k++)
+		{
+		    large[k] = ring.sub(large[k], ring.mul(fp, ring.sub(large[k*p], base)));
+		}
+		// a double division, fixed up by one, is much faster than a
+		// 64-bit one
+		double nd = (double)n;
+		for(long k=kSplit+1; k<=kMax; k++)
+		{
+		    long kp = k*p, q = (long)(nd/kp);
+		    if(q*kp > n) q--;
+		    else if((q+1)*kp <= n) q++;
+		    large[k] = ring.sub(large[k], ring.mul(fp, ring.sub(small[q], base)));
+		}
+		// v/p = q on the run [q*p, q*p+p)
+		for(long q=sqrtN/p; q>=p; q--)
+		{
+		    value_type d = ring.mul(fp, ring.sub(small[q], base));
+		    for(long v=std::min(sqrtN, q*p+p-1); v>=q*p; v--) small[v] = ring.sub(small[v], d);
+		}
+	    }
+	}
+
+	// the max range of the sums
+	long limit() const { return n; }
+
+	// the sum of f(p) for primes p <= v
+	value_type operator()(long v) const
+	{
+	    if(v<=sqrtN) return v<0 ? ring.from(0) : small[v];
+	    if(v>n || n/(n/v)!=v) return ring.from(0);
+	    return large[n/v];
+	}
+
+    private:
+	static long isqrt(long n)
+	{
+	    long r = (long)std::sqrt((double)n);
+	    while(r*r > n) r--;
+	    while((r+1)*(r+1) <= n) r++;
+	    return r;
+	}
+
+	long n, sqrtN;
+	Ring ring;
+	std::vector<value_type> small, large;
+    };
+
+    /**
+     * Primes in the Classes mod 4
+     * PARAMETERS: the max range (n), a long
+     * RETURN: the number of primes p <= n with p = 1 mod 4, and with p = 3
+     * mod 4, as a pair
+     * Notes: Combines the PrimeSum counts of the primes and of chi(p) for
+     * the character mod 4: the two classes are (pi(n) - 1 +- sum chi(p))/2.
+     */
+    std::pair<long, long> countPrimesMod4(long n);
+
+
+    // helpers for SummatoryFunction: the values of f up to max summed into
+    // prefix, and the sums of f*1 (the Dirichlet convolution with 1).  The
+    // sums of phi up to max are below max(max+1)/2, which fits in a long for
+    // max up to SUMMATORY_MAX_CUTOFF
+    static const long SUMMATORY_MAX_CUTOFF = (1L << 32) - 1;
+    void summatory_sieve(const TotientFunction & f, long max, std::vector<long> & prefix);
+    void summatory_sieve(const MobiusFunction & f, long max, std::vector<long> & prefix);
+
+    // phi*1 = n, whose sum is v(v+1)/2
+    template<class Ring>
+    typename Ring::value_type summatory_convolution(const TotientFunction & /*f*/, long v, const Ring & ring)
+    {
+	return v%2==0 ? ring.mul(ring.from(v/2), ring.from(v+1)) : ring.mul(ring.from(v), ring.from((v+1)/2));
+    }
+
+    // mu*1 is 1 at 1 and 0 elsewhere
+    template<class Ring>
+    typename Ring::value_type summatory_convolution(const MobiusFunction & /*f*/, long v, const Ring & ring)
+    {
+	return ring.from(v>=1);
+    }
+
+    /**
+     * Summatory Function
+     * The sum F(v) = f(1) + ... + f(v) of the totient (TotientFunction) or
+     * the Mobius function (MobiusFunction, giving the Mertens function), for
+     * every v of the form n/k (rounded down), by Du's sieve.  Since the
+     * convolution f*1 has an easy sum G,
+     *     F(v) = G(v) - sum_{d=2..v} F(v/d),
+     * where the v/d take O(sqrt(v)) distinct values.  F is tabulated up to
+     * a cutoff L with a linear sieve, and the v above it (which are n/k for
+     * k < n/L) are computed smallest first into a flat array indexed by k.
+     *
+     * CONSTRUCTOR PARAMETERS: the max range (n) of the sums (a long), and
+     * optionally the ring (see PrimeSum), the function, and the cutoff L.
+     * The default cutoff is n^(2/3)/2, and it is never below sqrt(n), nor
+     * above SUMMATORY_MAX_CUTOFF = 2^32-1 (32GB of table), which keeps the
+     * tabulated sums in a long; past n of about 8e14 the cutoff is clamped
+     * there, and the time grows as n/sqrt(L).
+     * Notes: Runs in O(n/sqrt(L) + L) time, which is O(n^(2/3)) for the
+     * default cutoff, and takes 8 bytes per integer up to L: n = 1e12 takes
+     * 400MB and about 4 seconds (7 modular).  operator() answers for
+     * 0 <= v <= L or v of the form n/k, and returns 0 otherwise.
+     * Examples:
+     *     nt::SummatoryFunction<nt::TotientFunction> Phi(n);
+     *     unsigned __int128 total = Phi(n);
+     *     nt::SummatoryFunction<nt::MobiusFunction, nt::ModularRing>
+     *         M(n, nt::ModularRing(1000000007));
+     */
+    template<class Function, class Ring = ExactRing>
+    class SummatoryFunction
+    {
+    public:
+	typedef typename Ring::value_type value_type;
+
+	explicit SummatoryFunction(long n, const Ring & ring = Ring(), const Function & f = Function(), long cutoff = 0) : n(std::max(n, 0L)), ring(ring)
+	{
+	    long sqrtN = (long)std::sqrt((double)this->n);
+	    while(sqrtN*sqrtN > this->n) sqrtN--;
+	    while((sqrtN+1)*(sqrtN+1) <= this->n) sqrtN++;
+	    if(cutoff<=0) cutoff = (long)(std::pow((double)this->n, 2.0/3)/2);
+	    this->cutoff = std::min(std::min(this->n, SUMMATORY_MAX_CUTOFF), std::max(cutoff, sqrtN));
+	    summatory_sieve(f, this->cutoff, prefix);
+
+	    long kMax = this->cutoff>0 ? this->n/(this->cutoff+1) : 0;
+	    large.assign(kMax+1, ring.from(0));
+	    for(long k=kMax; k>=1; k--)
+	    {
+		long v = this->n/k, r = (long)std::sqrt((double)v);
+		while(r*r > v) r--;
+		while((r+1)*(r+1) <= v) r++;
+		value_type sum = summatory_convolution(f, v, ring);
+		// d <= sqrt(v), with v/d = n/(k*d)
+		for(long d=2; d<=r; d++)
+		{
+		    long q = v/d;
+		    sum = ring.sub(sum, q<=this->cutoff ? ring.from(prefix[q]) : large[k*d]);
+		}
+		// d > sqrt(v), grouped by q = v/d <= sqrt(v)
+		for(long q=1; q<=v/(r+1); q++)
+		{
+		    long count = v/q - std::max(v/(q+1), r);
+		    sum = ring.sub(sum, ring.mul(ring.from(count), ring.from(prefix[q])));
+		}
+		large[k] = sum;
+	    }
+	}
+
+	// the max range of the sums
+	long limit() const { return n; }
+
+	// f(1) + ... + f(v)
+	value_type operator()(long v) const
+	{
+	    if(v<=cutoff) return v<0 ? ring.from(0) : ring.from(prefix[v]);
+	    if(v>n || n/(n/v)!=v) return ring.from(0);
+	    return large[n/v];
+	}
+
+    private:
+	long n, cutoff;
+	Ring ring;
+	std::vector<long> prefix;
+	std::vector<value_type> large;
+    };
+
+    /**
+     * Totient Summatory Function
+     * PARAMETERS: the max range (n), a long
+     * RETURN: phi(1) + phi(2) + ... + phi(n), exactly
+     * Notes: see SummatoryFunction.  n = 1e12 takes about 4 seconds.
+     */
+    unsigned __int128 sumTotients(long n);
+
+    /**
+     * Mertens Function
+     * PARAMETERS: the max range (n), a long
+     * RETURN: mu(1) + mu(2) + ... + mu(n)
+     * Notes: see SummatoryFunction.  n = 1e12 takes about 4 seconds.
+     */
+    long mertens(long n);
+
+}
+
+#endif